@@ -16,37 +16,83 @@
 // MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
 // Lesser General Public License for more details.
 //
-#include <inttypes.h>
+#include <Arduino.h>
 #include "Debug.h"
 
+static const char hexChar[] = "0123456789ABCDEF";
+
+char * formatHex(const uint8_t val, char *buf) {
+  buf[0] = hexChar[val >> 4];
+  buf[1] = hexChar[val & 0x0f];
+  buf[2] = '\0';
+  return buf;
+}
+
+char * formatHex(const uint16_t val, char *buf) {
+  buf[0] = hexChar[(val >> 12) & 0x0f];
+  buf[1] = hexChar[(val >> 8) & 0x0f];
+  buf[2] = hexChar[(val >> 4) & 0x0f];
+  buf[3] = hexChar[val & 0x0f];
+  buf[4] = '\0';
+  return buf;
+}
+
+char * formatHex(uint32_t val, char *buf) {
+  for (int i=7; i>=0; i--) {
+    buf[i] = hexChar[val & 0x0f];
+    val = val >> 4;
+  }
+  buf[8] = '\0';
+  return buf;
+}
+
+char * formatHexDump(const uint8_t *data, size_t len, char *buf, size_t bufSize) {
+  size_t pos = 0;
+  size_t i = 0;
+  for (; i < len; i++) {
+    size_t sep = (i > 0) ? 1 : 0;
+    // room for the terminating 0, and for " .." if more bytes follow
+    size_t reserve = (i + 1 < len) ? 4 : 1;
+    if (pos + sep + 2 + reserve > bufSize) break;
+    if (sep) buf[pos++] = ' ';
+    buf[pos++] = hexChar[data[i] >> 4];
+    buf[pos++] = hexChar[data[i] & 0x0f];
+  }
+  if ((i < len) && (pos + 4 <= bufSize)) {
+    buf[pos++] = ' ';
+    buf[pos++] = '.';
+    buf[pos++] = '.';
+  }
+  if (bufSize > 0) buf[pos] = '\0';
+  return buf;
+}
+
 #ifdef DEBUG
 
-static const char hexChar[] = "0123456789ABCDEF";
 static char hexBuffer[9];
 
 char * formatHex(const uint8_t val) {
-  hexBuffer[0] = hexChar[val >> 4];
-  hexBuffer[1] = hexChar[val & 0x0f];
-  hexBuffer[2] = '\0';
-  return hexBuffer;
+  return formatHex(val, hexBuffer);
 }
 
 char * formatHex(const uint16_t val) {
-  hexBuffer[0] = hexChar[(val >> 12) & 0x0f];
-  hexBuffer[1] = hexChar[(val >> 8) & 0x0f];
-  hexBuffer[2] = hexChar[(val >> 4) & 0x0f];
-  hexBuffer[3] = hexChar[val & 0x0f];
-  hexBuffer[4] = '\0';
-  return hexBuffer;
+  return formatHex(val, hexBuffer);
 }
 
 char * formatHex(uint32_t val) {
-  for (int i=7; i>=0; i--) {
-    hexBuffer[i] = hexChar[val & 0x0f];
-    val = val >> 4;
+  return formatHex(val, hexBuffer);
+}
+
+/*
+ * One Serial.print per 16 bytes instead of two per byte
+ */
+void debugHexDump(const uint8_t *data, size_t len) {
+  char line[16*3];
+  for (size_t i = 0; i < len; i += 16) {
+    size_t n = (len - i < 16) ? (len - i) : 16;
+    if (i > 0) Serial.print(" ");
+    Serial.print(formatHexDump(data + i, n, line, sizeof(line)));
   }
-  hexBuffer[8] = '\0';
-  return hexBuffer;
 }
 
 #endif
@@ -19,16 +19,31 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include <inttypes.h>
+#include <stddef.h>
+
 #ifdef DEBUG
 #define PN5180DEBUG(msg) Serial.print(msg)
+// prints data as hex bytes, formatted in blocks instead of byte by byte
+#define PN5180DEBUG_HEX(data, len) debugHexDump(data, len)
 #else
 #define PN5180DEBUG(msg)
+#define PN5180DEBUG_HEX(data, len)
 #endif
 
 #ifdef DEBUG
+// not reentrant, the result is overwritten by the next call
 extern char * formatHex(const uint8_t val);
 extern char * formatHex(const uint16_t val);
 extern char * formatHex(const uint32_t val);
+extern void debugHexDump(const uint8_t *data, size_t len);
 #endif
 
+// reentrant, buf holds 3, 5 or 9 characters
+extern char * formatHex(const uint8_t val, char *buf);
+extern char * formatHex(const uint16_t val, char *buf);
+extern char * formatHex(const uint32_t val, char *buf);
+// "01 02 03", data not fitting into bufSize is cut off with " .."
+extern char * formatHexDump(const uint8_t *data, size_t len, char *buf, size_t bufSize);
+
 #endif /* DEBUG_H */
@@ -20,29 +20,122 @@
 
 #include <Arduino.h>
 #include "PN5180.h"
+#include "PN5180Trace.h"
 #include "Debug.h"
+#ifdef PN5180_FREERTOS
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
 
 // PN5180 1-Byte Direct Commands
 // see 11.4.3.3 Host Interface Command List
 #define PN5180_WRITE_REGISTER           (0x00)
 #define PN5180_WRITE_REGISTER_OR_MASK   (0x01)
 #define PN5180_WRITE_REGISTER_AND_MASK  (0x02)
+#define PN5180_WRITE_REGISTER_MULTIPLE  (0x03)
 #define PN5180_READ_REGISTER            (0x04)
 #define PN5180_WRITE_EEPROM				(0x06)
 #define PN5180_READ_EEPROM              (0x07)
 #define PN5180_SEND_DATA                (0x09)
 #define PN5180_READ_DATA                (0x0A)
 #define PN5180_SWITCH_MODE              (0x0B)
+#define PN5180_MIFARE_AUTHENTICATE      (0x0C)
 #define PN5180_LOAD_RF_CONFIG           (0x11)
 #define PN5180_RF_ON                    (0x16)
 #define PN5180_RF_OFF                   (0x17)
 
-uint8_t PN5180::readBuffer[508];
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+#define PN5180_ISR_ATTR IRAM_ATTR
+#else
+#define PN5180_ISR_ATTR
+#endif
+
+// buffer of readData(len) for the instances without own buffer
+static uint8_t sharedReadBuffer[PN5180_READ_BUFFER_SIZE];
+
+#ifdef PN5180_FREERTOS
+#if !defined(ARDUINO_ARCH_ESP32)
+#error "PN5180_FREERTOS is supported on ESP32 only"
+#endif
+// waits without IRQ pin spin this long before sleeping one tick
+#ifndef PN5180_FREERTOS_SPIN_US
+#define PN5180_FREERTOS_SPIN_US 1000
+#endif
+// task blocked in waitForIRQ(), woken by the handler of its slot
+static TaskHandle_t volatile irqTasks[PN5180_MAX_IRQ_PINS];
+
+static inline void PN5180_ISR_ATTR notifyIRQTask(uint8_t slot) {
+  TaskHandle_t task = irqTasks[slot];
+  if (task) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+  }
+}
+#define PN5180_NOTIFY_IRQ_TASK(slot) notifyIRQTask(slot)
+#else
+#define PN5180_NOTIFY_IRQ_TASK(slot)
+#endif
+
+/*
+ * Interrupt handlers for the IRQ pin. attachInterrupt() does not pass an
+ * argument on all platforms, so there is one handler per slot which only
+ * flags the event. All further processing is done outside the ISR.
+ */
+static volatile bool irqFlags[PN5180_MAX_IRQ_PINS];
+static bool irqSlotUsed[PN5180_MAX_IRQ_PINS];
+
+static void PN5180_ISR_ATTR irqHandler0() { irqFlags[0] = true; PN5180_NOTIFY_IRQ_TASK(0); }
+static void PN5180_ISR_ATTR irqHandler1() { irqFlags[1] = true; PN5180_NOTIFY_IRQ_TASK(1); }
+static void PN5180_ISR_ATTR irqHandler2() { irqFlags[2] = true; PN5180_NOTIFY_IRQ_TASK(2); }
+static void PN5180_ISR_ATTR irqHandler3() { irqFlags[3] = true; PN5180_NOTIFY_IRQ_TASK(3); }
+
+/*
+ * Bits of shadowed registers which are changed by the PN5180 itself and
+ * therefore never known: SYSTEM_CONFIG.COMMAND.
+ */
+static uint32_t shadowVolatile(uint8_t reg) {
+  return (SYSTEM_CONFIG == reg) ? 0x00000007 : 0;
+}
+
+static void (* const irqHandlers[PN5180_MAX_IRQ_PINS])() = {
+  irqHandler0, irqHandler1, irqHandler2, irqHandler3
+};
+
+PN5180::PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi)
+       : PN5180(SSpin, BUSYpin, RSTpin, PN5180_NO_IRQ_PIN, spi) {
+}
 
-PN5180::PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin) {
+/*
+ * With an IRQ pin given, all waits for IRQ_STATUS flags (RF on/off, end of
+ * reception, reset) are signalled by the PN5180 IRQ line instead of polling
+ * the IRQ_STATUS register via SPI. The IRQ pin has to be configured active
+ * high (default of IRQ_PIN_CONFIG in EEPROM).
+ * The SPIClass is kept as reference, so several instances can share one bus
+ * or use different buses (e.g. HSPI/VSPI on ESP32).
+ */
+PN5180::PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi)
+       : arduinoHAL(spi) {
+  hal = &arduinoHAL;
   PN5180_NSS = SSpin;
   PN5180_BUSY = BUSYpin;
   PN5180_RST = RSTpin;
+  PN5180_IRQ = IRQpin;
+  irqSlot = -1;
+  irqEnable = 0;
+  invalidateRegisterCache();
+  registerBatch[0] = PN5180_WRITE_REGISTER_MULTIPLE;
+  registerBatchCount = 0;
+  registerBatchDepth = 0;
+  asyncState = PN5180_TS_Idle;
+  asyncCallback = 0;
+  readBuffer = sharedReadBuffer;
+  readBufferSize = sizeof(sharedReadBuffer);
+  lpcdReference = 0;
+  lpcdThreshold = 0x03;
+  lpcdConfigLoaded = false;
+  rfOn = false;
+  resetStats();
 
   /*
    * 11.4.1 Physical Host Interface
@@ -51,19 +144,51 @@ PN5180::PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin) {
    * = 0 and CPHA = 0.
    */
   // Settings for PN5180: 7Mbps, MSB first, SPI_MODE0 (CPOL=0, CPHA=0)
-  SPI_SETTINGS = SPISettings(7000000, MSBFIRST, SPI_MODE0);
+  setSPIClock(PN5180_SPI_CLOCK);
+}
+
+/*
+ * SPI, GPIO and timing of the host interface through hal instead of the
+ * Arduino functions, hal must exist as long as this instance
+ */
+PN5180::PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal)
+       : PN5180(SSpin, BUSYpin, RSTpin, IRQpin, SPI) {
+  this->hal = &hal;
+  setSPIClock(PN5180_SPI_CLOCK);
 }
 
 
 void PN5180::begin() {
-  pinMode(PN5180_NSS, OUTPUT);
-  pinMode(PN5180_BUSY, INPUT);
-  pinMode(PN5180_RST, OUTPUT);
-
-  digitalWrite(PN5180_NSS, HIGH); // disable
-  digitalWrite(PN5180_RST, HIGH); // no reset
+  hal->setPinMode(PN5180_NSS, OUTPUT);
+  hal->setPinMode(PN5180_BUSY, INPUT);
+  hal->setPinMode(PN5180_RST, OUTPUT);
+
+  hal->writePin(PN5180_NSS, HIGH); // disable
+  hal->writePin(PN5180_RST, HIGH); // no reset
+
+  if (PN5180_NO_IRQ_PIN != PN5180_IRQ && irqSlot < 0) {
+    for (int8_t i=0; i<PN5180_MAX_IRQ_PINS; i++) {
+      if (!irqSlotUsed[i]) {
+        irqSlotUsed[i] = true;
+        irqSlot = i;
+        break;
+      }
+    }
+    if (irqSlot >= 0) {
+      hal->setPinMode(PN5180_IRQ, INPUT);
+      irqFlags[irqSlot] = false;
+      if (!hal->attachIRQ(PN5180_IRQ, irqHandlers[irqSlot])) {
+        PN5180DEBUG(F("*** ERROR: IRQ pin without interrupt, falling back to polling!\n"));
+        irqSlotUsed[irqSlot] = false;
+        irqSlot = -1;
+      }
+    }
+    else {
+      PN5180DEBUG(F("*** ERROR: No free IRQ slot, falling back to polling!\n"));
+    }
+  }
 
-  SPI.begin();
+  hal->spiBegin();
   PN5180DEBUG(F("SPI pinout: "));
   PN5180DEBUG(F("SS=")); PN5180DEBUG(SS);
   PN5180DEBUG(F(", MOSI=")); PN5180DEBUG(MOSI);
@@ -73,8 +198,13 @@ void PN5180::begin() {
 }
 
 void PN5180::end() {
-  digitalWrite(PN5180_NSS, HIGH); // disable
-  SPI.end();
+  hal->writePin(PN5180_NSS, HIGH); // disable
+  if (irqSlot >= 0) {
+    hal->detachIRQ(PN5180_IRQ);
+    irqSlotUsed[irqSlot] = false;
+    irqSlot = -1;
+  }
+  hal->spiEnd();
 }
 
 /*
@@ -89,10 +219,8 @@ bool PN5180::writeRegister(uint8_t reg, uint32_t value) {
 #ifdef DEBUG
   PN5180DEBUG(F("Write Register 0x"));
   PN5180DEBUG(formatHex(reg));
-  PN5180DEBUG(F(", value (LSB first)=0x"));
-  for (int i=0; i<4; i++) {
-    PN5180DEBUG(formatHex(p[i]));
-  }
+  PN5180DEBUG(F(", value (LSB first)="));
+  PN5180DEBUG_HEX(p, 4);
   PN5180DEBUG("\n");
 #endif
 
@@ -100,13 +228,24 @@ bool PN5180::writeRegister(uint8_t reg, uint32_t value) {
   For all 4 byte command parameter transfers (e.g. register values), the payload
   parameters passed follow the little endian approach (Least Significant Byte first).
    */
-  uint8_t buf[6] = { PN5180_WRITE_REGISTER, reg, p[0], p[1], p[2], p[3] };
+  bool success;
+  if (registerBatchDepth > 0) {
+    success = queueRegisterWrite(reg, 0x01, value);
+  }
+  else {
+    uint8_t buf[6] = { PN5180_WRITE_REGISTER, reg, p[0], p[1], p[2], p[3] };
 
-  SPI.beginTransaction(SPI_SETTINGS);
-  transceiveCommand(buf, 6);
-  SPI.endTransaction();
+    hal->beginTransaction();
+    success = transceiveCommand(buf, 6);
+    hal->endTransaction();
+  }
 
-  return true;
+  int8_t i = shadowIndex(reg);
+  if (success && i >= 0) {
+    shadowValue[i] = value;
+    shadowKnown[i] = ~shadowVolatile(reg);
+  }
+  return success;
 }
 
 /*
@@ -120,23 +259,37 @@ bool PN5180::writeRegister(uint8_t reg, uint32_t value) {
 bool PN5180::writeRegisterWithOrMask(uint8_t reg, uint32_t mask) {
   uint8_t *p = (uint8_t*)&mask;
 
+  // skip, if all bits to set are known to be set already
+  int8_t i = shadowIndex(reg);
+  if (i >= 0 && 0 == (mask & ~(shadowKnown[i] & shadowValue[i]))) {
+    return true;
+  }
+
 #ifdef DEBUG
   PN5180DEBUG(F("Write Register 0x"));
   PN5180DEBUG(formatHex(reg));
-  PN5180DEBUG(F(" with OR mask (LSB first)=0x"));
-  for (int i=0; i<4; i++) {
-    PN5180DEBUG(formatHex(p[i]));
-  }
+  PN5180DEBUG(F(" with OR mask (LSB first)="));
+  PN5180DEBUG_HEX(p, 4);
   PN5180DEBUG("\n");
 #endif
 
-  uint8_t buf[6] = { PN5180_WRITE_REGISTER_OR_MASK, reg, p[0], p[1], p[2], p[3] };
+  bool success;
+  if (registerBatchDepth > 0) {
+    success = queueRegisterWrite(reg, 0x02, mask);
+  }
+  else {
+    uint8_t buf[6] = { PN5180_WRITE_REGISTER_OR_MASK, reg, p[0], p[1], p[2], p[3] };
 
-  SPI.beginTransaction(SPI_SETTINGS);
-  transceiveCommand(buf, 6);
-  SPI.endTransaction();
+    hal->beginTransaction();
+    success = transceiveCommand(buf, 6);
+    hal->endTransaction();
+  }
 
-  return true;
+  if (success && i >= 0) {
+    shadowValue[i] |= mask;
+    shadowKnown[i] |= mask & ~shadowVolatile(reg);
+  }
+  return success;
 }
 
 /*
@@ -150,23 +303,96 @@ bool PN5180::writeRegisterWithOrMask(uint8_t reg, uint32_t mask) {
 bool PN5180::writeRegisterWithAndMask(uint8_t reg, uint32_t mask) {
   uint8_t *p = (uint8_t*)&mask;
 
+  // skip, if all bits to clear are known to be cleared already
+  int8_t i = shadowIndex(reg);
+  if (i >= 0 && 0 == (~mask & ~(shadowKnown[i] & ~shadowValue[i]))) {
+    return true;
+  }
+
 #ifdef DEBUG
   PN5180DEBUG(F("Write Register 0x"));
   PN5180DEBUG(formatHex(reg));
-  PN5180DEBUG(F(" with AND mask (LSB first)=0x"));
-  for (int i=0; i<4; i++) {
-    PN5180DEBUG(formatHex(p[i]));
-  }
+  PN5180DEBUG(F(" with AND mask (LSB first)="));
+  PN5180DEBUG_HEX(p, 4);
   PN5180DEBUG("\n");
 #endif
 
-  uint8_t buf[6] = { PN5180_WRITE_REGISTER_AND_MASK, reg, p[0], p[1], p[2], p[3] };
+  bool success;
+  if (registerBatchDepth > 0) {
+    success = queueRegisterWrite(reg, 0x03, mask);
+  }
+  else {
+    uint8_t buf[6] = { PN5180_WRITE_REGISTER_AND_MASK, reg, p[0], p[1], p[2], p[3] };
 
-  SPI.beginTransaction(SPI_SETTINGS);
-  transceiveCommand(buf, 6);
-  SPI.endTransaction();
+    hal->beginTransaction();
+    success = transceiveCommand(buf, 6);
+    hal->endTransaction();
+  }
 
-  return true;
+  if (success && i >= 0) {
+    shadowValue[i] &= mask;
+    shadowKnown[i] |= ~mask & ~shadowVolatile(reg);
+  }
+  return success;
+}
+
+/*
+ * WRITE_REGISTER_MULTIPLE - 0x03
+ * This command is used to write multiple registers with one command. The payload is an
+ * array of up to 43 elements {address, action, value}, action 0x01 writes the value,
+ * 0x02 performs an OR and 0x03 an AND with the value.
+ *
+ * Between beginRegisterBatch() and endRegisterBatch(), writeRegister(),
+ * writeRegisterWithOrMask() and writeRegisterWithAndMask() are queued instead of being
+ * sent. The queue is sent as one WRITE_REGISTER_MULTIPLE command at endRegisterBatch(),
+ * when it is full or before any other host command, so the order of all commands is kept.
+ * Batches can be nested, only the outermost endRegisterBatch() sends the queue.
+ * Returns false, if sending the queue failed.
+ */
+void PN5180::beginRegisterBatch() {
+  registerBatchDepth++;
+}
+
+bool PN5180::endRegisterBatch() {
+  if (registerBatchDepth > 0) registerBatchDepth--;
+  if (registerBatchDepth > 0 || 0 == registerBatchCount) return true;
+
+  hal->beginTransaction();
+  bool success = flushRegisterBatch();
+  hal->endTransaction();
+  return success;
+}
+
+bool PN5180::queueRegisterWrite(uint8_t reg, uint8_t action, uint32_t value) {
+  bool success = true;
+  if (registerBatchCount >= PN5180_REGISTER_BATCH_SIZE) {
+    hal->beginTransaction();
+    success = flushRegisterBatch();
+    hal->endTransaction();
+  }
+
+  uint8_t *p = &registerBatch[1 + 6*registerBatchCount];
+  p[0] = reg;
+  p[1] = action;
+  p[2] = (uint8_t)(value);
+  p[3] = (uint8_t)(value >> 8);
+  p[4] = (uint8_t)(value >> 16);
+  p[5] = (uint8_t)(value >> 24);
+  registerBatchCount++;
+  return success;
+}
+
+/*
+ * Send the queued register writes, called within an SPI transaction.
+ */
+bool PN5180::flushRegisterBatch() {
+  size_t len = 1 + 6*registerBatchCount;
+  registerBatchCount = 0;
+  bool success = transceiveCommand(registerBatch, len);
+  if (!success) {
+    invalidateRegisterCache();
+  }
+  return success;
 }
 
 /*
@@ -183,15 +409,20 @@ bool PN5180::readRegister(uint8_t reg, uint32_t *value) {
 
   uint8_t cmd[2] = { PN5180_READ_REGISTER, reg };
 
-  SPI.beginTransaction(SPI_SETTINGS);
-  transceiveCommand(cmd, 2, (uint8_t*)value, 4);
-  SPI.endTransaction();
+  hal->beginTransaction();
+  bool success = transceiveCommand(cmd, 2, (uint8_t*)value, 4);
+  hal->endTransaction();
 
   PN5180DEBUG(F("Register value=0x"));
   PN5180DEBUG(formatHex(*value));
   PN5180DEBUG("\n");
 
-  return true;
+  int8_t i = shadowIndex(reg);
+  if (success && i >= 0) {
+    shadowValue[i] = *value;
+    shadowKnown[i] = ~shadowVolatile(reg);
+  }
+  return success;
 }
 
 /*
@@ -202,10 +433,38 @@ bool PN5180::writeEEprom(uint8_t addr, uint8_t *buffer, uint8_t len) {
 	cmd[0] = PN5180_WRITE_EEPROM;
 	cmd[1] = addr;
 	for (int i = 0; i < len; i++) cmd[2 + i] = buffer[i];
-	SPI.beginTransaction(SPI_SETTINGS);
-	transceiveCommand(cmd, len + 2);
-	SPI.endTransaction();
-	return true;
+	hal->beginTransaction();
+	bool success = transceiveCommand(cmd, len + 2);
+	hal->endTransaction();
+	return success;
+}
+
+/*
+ * Write an EEPROM block only if its content differs. The block is read
+ * with one READ_EEPROM command, only the range from the first to the last
+ * differing byte is written with one WRITE_EEPROM command.
+ * Saves EEPROM write cycles and time, e.g. when the same configuration is
+ * set after every wake-up.
+ */
+bool PN5180::updateEEprom(uint8_t addr, uint8_t *buffer, uint8_t len) {
+	uint8_t current[len];
+	if (!readEEprom(addr, current, len)) return false;
+
+	int first = -1, last = -1;
+	for (int i = 0; i < len; i++) {
+		if (current[i] != buffer[i]) {
+			if (first < 0) first = i;
+			last = i;
+		}
+	}
+	if (first < 0) return true; // unchanged
+
+	PN5180DEBUG(F("Update EEPROM at 0x"));
+	PN5180DEBUG(formatHex((uint8_t)(addr + first)));
+	PN5180DEBUG(F(", size="));
+	PN5180DEBUG(last - first + 1);
+	PN5180DEBUG("\n");
+	return writeEEprom(addr + first, buffer + first, last - first + 1);
 }
 
 /*
@@ -233,16 +492,14 @@ bool PN5180::readEEprom(uint8_t addr, uint8_t *buffer, int len) {
 
   uint8_t cmd[3] = { PN5180_READ_EEPROM, addr, uint8_t(len) };
 
-  SPI.beginTransaction(SPI_SETTINGS);
-  transceiveCommand(cmd, 3, buffer, len);
-  SPI.endTransaction();
+  hal->beginTransaction();
+  bool success = transceiveCommand(cmd, 3, buffer, len);
+  hal->endTransaction();
+  if (!success) return false;
 
 #ifdef DEBUG
   PN5180DEBUG(F("EEPROM values: "));
-  for (int i=0; i<len; i++) {
-    PN5180DEBUG(formatHex(buffer[i]));
-    PN5180DEBUG(" ");
-  }
+  PN5180DEBUG_HEX(buffer, len);
   PN5180DEBUG("\n");
 #endif
 
@@ -266,31 +523,45 @@ bool PN5180::readEEprom(uint8_t addr, uint8_t *buffer, int len) {
  * with ‘Transceive’ command set. If the condition is not fulfilled, an exception is raised.
  */
 bool PN5180::sendData(uint8_t *data, int len, uint8_t validBits) {
-  if (len > 260) {
-    PN5180DEBUG(F("ERROR: sendData with more than 260 bytes is not supported!\n"));
+  if (!startTransceiveCycle()) {
     return false;
   }
+  return sendDataFast(data, len, validBits);
+}
 
-#ifdef DEBUG
-  PN5180DEBUG(F("Send data (len="));
-  PN5180DEBUG(len);
-  PN5180DEBUG(F("):"));
-  for (int i=0; i<len; i++) {
-    PN5180DEBUG(" ");
-    PN5180DEBUG(formatHex(data[i]));
+/*
+ * Same as sendData(), for frames prepared by the caller: frame[0..1] are
+ * reserved for the SEND_DATA header and set here, the RF data starts at
+ * frame[2]. The optional data (e.g. block data of a write) is sent in the
+ * same SPI frame, so neither part is copied.
+ */
+bool PN5180::sendDataFrame(uint8_t *frame, int frameLen, uint8_t *data, int len) {
+  if ((frameLen < 2) || (frameLen - 2 + len > 260)) {
+    PN5180DEBUG(F("ERROR: sendData with more than 260 bytes is not supported!\n"));
+    return false;
   }
-  PN5180DEBUG("\n");
-#endif
-
-  uint8_t buffer[len+2];
-  buffer[0] = PN5180_SEND_DATA;
-  buffer[1] = validBits; // number of valid bits of last byte are transmitted (0 = all bits are transmitted)
-  for (int i=0; i<len; i++) {
-    buffer[2+i] = data[i];
+  if (!startTransceiveCycle()) {
+    return false;
   }
+  frame[0] = PN5180_SEND_DATA;
+  frame[1] = 0x00; // all bits of the last byte
+
+  hal->beginTransaction();
+  bool success = transceiveCommand(frame, frameLen, data, len, 0, 0);
+  hal->endTransaction();
+
+  return success;
+}
 
+/*
+ * Restart the transceive cycle, the transceiver waits for the next
+ * SEND_DATA afterwards
+ */
+bool PN5180::startTransceiveCycle() {
+  beginRegisterBatch();
   writeRegisterWithAndMask(SYSTEM_CONFIG, 0xfffffff8);  // Idle/StopCom Command
   writeRegisterWithOrMask(SYSTEM_CONFIG, 0x00000003);   // Transceive Command
+  endRegisterBatch();
   /*
    * Transceive command; initiates a transceive cycle.
    * Note: Depending on the value of the Initiator bit, a
@@ -305,10 +576,40 @@ bool PN5180::sendData(uint8_t *data, int len, uint8_t validBits) {
     PN5180DEBUG(F("*** ERROR: Transceiver not in state WaitTransmit!?\n"));
     return false;
   }
+  return true;
+}
+
+/*
+ * SEND_DATA - 0x09, without restarting the transceive cycle
+ * After a frame has been received, the transceiver returns to 'WaitTransmit'
+ * and stays in the transceive cycle, so the following frames of one exchange
+ * (e.g. anticollision and SELECT) can be sent with the SEND_DATA command only.
+ * Precondition: the transceive cycle was started with sendData() and the
+ * response of the previous frame has been received completely.
+ * The command header and the caller's data are sent in one SPI frame
+ * without copying.
+ */
+bool PN5180::sendDataFast(uint8_t *data, int len, uint8_t validBits) {
+  if (len > 260) {
+    PN5180DEBUG(F("ERROR: sendData with more than 260 bytes is not supported!\n"));
+    return false;
+  }
+
+#ifdef DEBUG
+  PN5180DEBUG(F("Send data (len="));
+  PN5180DEBUG(len);
+  PN5180DEBUG(F("): "));
+  PN5180DEBUG_HEX(data, len);
+  PN5180DEBUG("\n");
+#endif
 
-  SPI.beginTransaction(SPI_SETTINGS);
-  bool success = transceiveCommand(buffer, len+2);
-  SPI.endTransaction();
+  uint8_t header[2];
+  header[0] = PN5180_SEND_DATA;
+  header[1] = validBits; // number of valid bits of last byte are transmitted (0 = all bits are transmitted)
+
+  hal->beginTransaction();
+  bool success = transceiveCommand(header, 2, data, len, 0, 0);
+  hal->endTransaction();
 
   return success;
 }
@@ -322,10 +623,13 @@ bool PN5180::sendData(uint8_t *data, int len, uint8_t validBits) {
  * The RF data had been successfully received. In case the instruction is executed without
  * preceding an RF data reception, no exception is raised but the data read back from the
  * reception buffer is invalid. If the condition is not fulfilled, an exception is raised.
+ *
+ * readData(len) reads into the instance's receive buffer, which is overwritten by the
+ * next call. readData(len, buffer) transfers the data directly into the caller's buffer.
  */
 uint8_t * PN5180::readData(int len) {
-  if (len > 508) {
-    Serial.println(F("*** FATAL: Reading more than 508 bytes is not supported!"));
+  if (len > readBufferSize) {
+    Serial.println(F("*** FATAL: Reading more than the receive buffer size is not supported!"));
     return 0L;
   }
 
@@ -335,107 +639,273 @@ uint8_t * PN5180::readData(int len) {
 
   uint8_t cmd[2] = { PN5180_READ_DATA, 0x00 };
 
-  SPI.beginTransaction(SPI_SETTINGS);
+  hal->beginTransaction();
   transceiveCommand(cmd, 2, readBuffer, len);
-  SPI.endTransaction();
+  hal->endTransaction();
 
 #ifdef DEBUG
   PN5180DEBUG(F("Data read: "));
-  for (int i=0; i<len; i++) {
-    PN5180DEBUG(formatHex(readBuffer[i]));
-    PN5180DEBUG(" ");
-  }
+  PN5180DEBUG_HEX(readBuffer, len);
   PN5180DEBUG("\n");
 #endif
 
   return readBuffer;
 }
 
-bool PN5180::readData(uint8_t len, uint8_t *buffer) {
-	if (len > 508) {
+bool PN5180::readData(uint16_t len, uint8_t *buffer) {
+	if (len > PN5180_RX_BUFFER_MAX) {
 		return false;
 	}
 	uint8_t cmd[2] = { PN5180_READ_DATA, 0x00 };
-	SPI.beginTransaction(SPI_SETTINGS);
+	hal->beginTransaction();
 	bool success = transceiveCommand(cmd, 2, buffer, len);
-	SPI.endTransaction();
+	hal->endTransaction();
 	return success;
 }
 
-/* prepare LPCD registers */
+/*
+ * Give the instance its own buffer for readData(len), e.g. for several
+ * readers used alternately. By default all instances share one buffer of
+ * PN5180_READ_BUFFER_SIZE bytes. size : PN5180_READ_BUFFER_MIN..508 bytes
+ */
+void PN5180::setReadBuffer(uint8_t *buffer, uint16_t size) {
+  if ((0 == buffer) || (size < PN5180_READ_BUFFER_MIN)) {
+    PN5180DEBUG(F("*** ERROR: Read buffer too small!\n"));
+    return;
+  }
+  readBuffer = buffer;
+  readBufferSize = (size > PN5180_RX_BUFFER_MAX) ? PN5180_RX_BUFFER_MAX : size;
+}
+
+uint16_t PN5180::getReadBufferSize() {
+  return readBufferSize;
+}
+
+/*
+ * prepare LPCD registers with the default configuration and the threshold
+ * stored in the EEPROM, e.g. by calibrateLPCD() before a deep sleep
+ */
 bool PN5180::prepareLPCD() {
+  if (!loadLPCDConfig()) return false;
+  return prepareLPCD(0xF0, lpcdThreshold, PN5180_LPCD_SELF_CALIBRATION);
+}
+
+/*
+ * Read reference value and threshold from the EEPROM once, the values in
+ * RAM are lost with a deep sleep of the host
+ */
+bool PN5180::loadLPCDConfig() {
+  if (lpcdConfigLoaded) return true;
+  uint8_t data[4]; // LPCD_REFERENCE_VALUE (2 bytes), LPCD_FIELD_ON_TIME, LPCD_THRESHOLD
+  if (!readEEprom(LPCD_REFERENCE_VALUE, data, sizeof(data))) return false;
+  lpcdReference = (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+  lpcdThreshold = data[3];
+  lpcdConfigLoaded = true;
+  return true;
+}
+
+/* prepare LPCD registers
+ * fieldOnTime : LPCD_FIELD_ON_TIME, 62us + 8us * value
+ * threshold   : AGC_LPCD_THRESHOLD, AGC difference to the reference value detecting a card
+ * mode        : PN5180_LPCD_SELF_CALIBRATION or PN5180_LPCD_AUTO_CALIBRATION
+ * EEPROM block 0x36..0x3A is only written if it differs from the
+ * LPCD configuration, so this can be called after every wake-up.
+ */
+bool PN5180::prepareLPCD(uint8_t fieldOnTime, uint8_t threshold, uint8_t mode) {
   //=======================================LPCD CONFIG================================================================================
   PN5180DEBUG(F("----------------------------------"));
   PN5180DEBUG(F("prepare LPCD..."));
 
-  uint8_t data[255];
-  uint8_t response[256];
+  uint8_t data[5];
     //1. Set Fieldon time                                           LPCD_FIELD_ON_TIME (0x36)
-  uint8_t fieldOn = 0xF0;//0x## -> ##(base 10) x 8μs + 62 μs
-  data[0] = fieldOn;
-  writeEEprom(0x36, data, 1);
-  readEEprom(0x36, response, 1);
-  fieldOn = response[0];
-  PN5180DEBUG("LPCD-fieldOn time: ");
-  PN5180DEBUG(formatHex(fieldOn));
-
+  data[0] = fieldOnTime;
     //2. Set threshold level                                         AGC_LPCD_THRESHOLD @ EEPROM 0x37
-  uint8_t threshold = 0x03;
-  data[0] = threshold;
-  writeEEprom(0x37, data, 1);
-  readEEprom(0x37, response, 1);
-  threshold = response[0];
-  PN5180DEBUG("LPCD-threshold: ");
-  PN5180DEBUG(formatHex(threshold));
-
+  data[1] = threshold;
   //3. Select LPCD mode                                               LPCD_REFVAL_GPO_CONTROL (0x38)
-  uint8_t lpcdMode = 0x01; // 1 = LPCD SELF CALIBRATION 
-                           // 0 = LPCD AUTO CALIBRATION (this mode does not work, should look more into it, no reason why it shouldn't work)
-  data[0] = lpcdMode;
-  writeEEprom(0x38, data, 1);
-  readEEprom(0x38, response, 1);
-  lpcdMode = response[0];
-  PN5180DEBUG("lpcdMode: ");
-  PN5180DEBUG(formatHex(lpcdMode));
-  
+  data[2] = mode; // 1 = LPCD SELF CALIBRATION 
+                  // 0 = LPCD AUTO CALIBRATION, uses the reference value of calibrateLPCD()
   // LPCD_GPO_TOGGLE_BEFORE_FIELD_ON (0x39)
-  uint8_t beforeFieldOn = 0xF0; 
-  data[0] = beforeFieldOn;
-  writeEEprom(0x39, data, 1);
-  readEEprom(0x39, response, 1);
-  beforeFieldOn = response[0];
-  PN5180DEBUG("beforeFieldOn: ");
-  PN5180DEBUG(formatHex(beforeFieldOn));
-  
+  data[3] = 0xF0; 
   // LPCD_GPO_TOGGLE_AFTER_FIELD_ON (0x3A)
-  uint8_t afterFieldOn = 0xF0; 
-  data[0] = afterFieldOn;
-  writeEEprom(0x3A, data, 1);
-  readEEprom(0x3A, response, 1);
-  afterFieldOn = response[0];
-  PN5180DEBUG("afterFieldOn: ");
-  PN5180DEBUG(formatHex(afterFieldOn));
-  delay(100);
+  data[4] = 0xF0; 
+
+  // the reference value is kept, get it from the EEPROM first
+  if (!loadLPCDConfig()) return false;
+  if (!updateEEprom(LPCD_FIELD_ON_TIME, data, sizeof(data))) return false;
+  lpcdThreshold = threshold;
+  return true;
+}
+
+/*
+ * Read the current AGC value (AGC_REF_CONFIG). With RF on this is the
+ * antenna load, after an LPCD wake-up it holds the value of the last
+ * LPCD measurement.
+ */
+bool PN5180::readAGC(uint16_t *agc) {
+  uint32_t value;
+  if (!readRegister(AGC_REF_CONFIG, &value)) return false;
+  *agc = (uint16_t)(value & AGC_VALUE_MASK);
+  return true;
+}
+
+/*
+ * Measure the AGC value of the empty field and adapt the LPCD to the
+ * environment: the mean of several samples is the reference value (stored
+ * in LPCD_REFERENCE_VALUE for PN5180_LPCD_AUTO_CALIBRATION), the threshold
+ * is set to twice the measured noise (max - min), at least the default of 3.
+ * Metal near the antenna raises the noise, a fixed threshold then causes
+ * false wake-ups. Call with no card in the field, the RF field is switched
+ * off afterwards.
+ */
+bool PN5180::calibrateLPCD(uint8_t fieldOnTime, uint8_t mode, uint8_t samples) {
+  if (0 == samples) samples = 1;
+  if (!loadRFConfig(0x00, 0x80) || !setRF_on()) {
+    setRF_off();
+    return false;
+  }
+
+  uint32_t sum = 0;
+  uint16_t minAGC = AGC_VALUE_MASK, maxAGC = 0;
+  bool success = true;
+  for (uint8_t i=0; success && i<samples; i++) {
+    uint16_t agc;
+    success = readAGC(&agc);
+    sum += agc;
+    if (agc < minAGC) minAGC = agc;
+    if (agc > maxAGC) maxAGC = agc;
+  }
+  setRF_off();
+  if (!success) return false;
+
+  lpcdReference = (uint16_t)(sum / samples);
+  lpcdConfigLoaded = true;
+  uint16_t threshold = 2 * (maxAGC - minAGC);
+  if (threshold < 0x03) threshold = 0x03;
+  if (threshold > 0xff) threshold = 0xff;
+
+  PN5180DEBUG(F("LPCD reference="));
+  PN5180DEBUG(lpcdReference);
+  PN5180DEBUG(F(", noise="));
+  PN5180DEBUG(maxAGC - minAGC);
+  PN5180DEBUG(F(", threshold="));
+  PN5180DEBUG(threshold);
+  PN5180DEBUG("\n");
+
+  uint8_t reference[2] = { (uint8_t)(lpcdReference & 0xff), (uint8_t)(lpcdReference >> 8) };
+  if (!updateEEprom(LPCD_REFERENCE_VALUE, reference, sizeof(reference))) return false;
+  return prepareLPCD(fieldOnTime, (uint8_t)threshold, mode);
+}
+
+uint16_t PN5180::getLPCDReference() {
+  loadLPCDConfig();
+  return lpcdReference;
+}
+
+uint8_t PN5180::getLPCDThreshold() {
+  loadLPCDConfig();
+  return lpcdThreshold;
+}
+
+/*
+ * Difference of the AGC value of the last LPCD measurement to the reference
+ * value of calibrateLPCD(), call after the LPCD wake-up (before reset()).
+ * A wake-up with a delta much smaller than the distance of a real card
+ * can be treated as false wake-up and LPCD restarted.
+ */
+bool PN5180::getLPCDAGCDelta(int16_t *delta) {
+  uint16_t agc;
+  if (!loadLPCDConfig() || !readAGC(&agc)) return false;
+  *delta = (int16_t)agc - (int16_t)lpcdReference;
   return true;
 }
 
+/*
+ * RF duty cycle of LPCD in ppm: one field on period of
+ * 62us + 8us * fieldOnTime per wake-up period
+ */
+uint32_t PN5180::lpcdDutyCycle(uint8_t fieldOnTime, uint16_t wakeupCounterInMs) {
+  uint32_t onTimeUs = PN5180_LPCD_FIELD_ON_TIME_US(fieldOnTime);
+  uint32_t periodUs = 1000UL * wakeupCounterInMs + onTimeUs;
+  return (uint32_t)((1000000ULL * onTimeUs) / periodUs);
+}
+
+/*
+ * Estimated average current of the PN5180 in LPCD in uA, from the duty
+ * cycle and the currents with field on and in standby. The defaults are
+ * typical values, measure the field current for the actual antenna.
+ */
+uint32_t PN5180::lpcdAverageCurrent(uint8_t fieldOnTime, uint16_t wakeupCounterInMs,
+                                    uint32_t fieldCurrentUa, uint32_t standbyCurrentUa) {
+  uint32_t duty = lpcdDutyCycle(fieldOnTime, wakeupCounterInMs);
+  return standbyCurrentUa + (uint32_t)(((uint64_t)fieldCurrentUa * duty) / 1000000UL);
+}
+
 /* switch the mode to LPCD (low power card detection)
  * Parameter 'wakeupCounterInMs' must be in the range from 0x0 - 0xA82
  * max. wake-up time is 2960 ms.
  */
 bool PN5180::switchToLPCD(uint16_t wakeupCounterInMs) {
+  invalidateRegisterCache();
+  rfOn = false;
   // clear all IRQ flags
   clearIRQStatus(0xffffffff); 
   // enable only LPCD and general error IRQ
-  writeRegister(IRQ_ENABLE, LPCD_IRQ_STAT | GENERAL_ERROR_IRQ_STAT);  
+  irqEnable = LPCD_IRQ_STAT | GENERAL_ERROR_IRQ_STAT;
+  writeRegister(IRQ_ENABLE, irqEnable);
   // switch mode to LPCD 
   uint8_t cmd[4] = { PN5180_SWITCH_MODE, 0x01, (uint8_t)(wakeupCounterInMs & 0xFF), (uint8_t)((wakeupCounterInMs >> 8U) & 0xFF) };
-  SPI.beginTransaction(SPI_SETTINGS);
+  hal->beginTransaction();
   bool success = transceiveCommand(cmd, sizeof(cmd));
-  SPI.endTransaction();
+  hal->endTransaction();
   return success;
 }
 
+/*
+ * MIFARE_AUTHENTICATE - 0x0C
+ * This command performs the MIFARE Classic authentication on an activated card,
+ * Crypto1 is done by the PN5180. The key is 6 bytes, key type 0x60 (key A) or
+ * 0x61 (key B), uid are the 4 bytes of the UID used for the authentication
+ * (the last 4 bytes for 7 byte UIDs).
+ * After a successful authentication, MFC_CRYPTO_ON is set in SYSTEM_CONFIG and
+ * following frames (e.g. READ/WRITE) are encrypted until it is cleared again,
+ * as done by activateTypeA.
+ * Return value: MIFARE_AUTH_OK, MIFARE_AUTH_DENIED, MIFARE_AUTH_TIMEOUT or
+ * MIFARE_AUTH_ERROR
+ */
+uint8_t PN5180::mifareAuthenticate(uint8_t blockNo, const uint8_t *key, uint8_t keyType, const uint8_t *uid) {
+  uint8_t cmd[13];
+  cmd[0] = PN5180_MIFARE_AUTHENTICATE;
+  for (int i=0; i<6; i++) cmd[1+i] = key[i];
+  cmd[7] = keyType;
+  cmd[8] = blockNo;
+  for (int i=0; i<4; i++) cmd[9+i] = uid[i];
+
+  uint8_t status = MIFARE_AUTH_ERROR;
+  hal->beginTransaction();
+  bool success = transceiveCommand(cmd, sizeof(cmd), &status, 1);
+  hal->endTransaction();
+  if (!success) {
+    status = MIFARE_AUTH_ERROR;
+  }
+
+  PN5180DEBUG(F("MIFARE authenticate block "));
+  PN5180DEBUG(blockNo);
+  PN5180DEBUG(F(", status="));
+  PN5180DEBUG(formatHex(status));
+  PN5180DEBUG("\n");
+
+  // the PN5180 sets MFC_CRYPTO_ON on success
+  int8_t i = shadowIndex(SYSTEM_CONFIG);
+  if (MIFARE_AUTH_OK == status) {
+    shadowValue[i] |= MFC_CRYPTO_ON;
+    shadowKnown[i] |= MFC_CRYPTO_ON;
+  }
+  else {
+    shadowKnown[i] &= ~MFC_CRYPTO_ON;
+  }
+  return status;
+}
+
 /*
  * LOAD_RF_CONFIG - 0x11
  * Parameter 'Transmitter Configuration' must be in the range from 0x0 - 0x1C, inclusive. If
@@ -453,6 +923,9 @@ bool PN5180::switchToLPCD(uint16_t wakeupCounterInMs) {
  * ----------------------------------------------------------------------------------------------
  * ->0D              ISO 15693 ASK100  26        8D              ISO 15693   26
  *   0E              ISO 15693 ASK10   26        8E              ISO 15693   53
+ *
+ * The last loaded configuration is cached, loading the same configuration again is
+ * skipped. Call invalidateRegisterCache() after changing RF registers directly.
  */
 bool PN5180::loadRFConfig(uint8_t txConf, uint8_t rxConf) {
   PN5180DEBUG(F("Load RF-Config: txConf="));
@@ -461,13 +934,25 @@ bool PN5180::loadRFConfig(uint8_t txConf, uint8_t rxConf) {
   PN5180DEBUG(formatHex(rxConf));
   PN5180DEBUG("\n");
 
+  // skip, if the configuration is loaded already
+  if ((0xff == txConf || txConf == rfTxConfig) && (0xff == rxConf || rxConf == rfRxConfig)) {
+    PN5180DEBUG(F("RF-Config already loaded\n"));
+    return true;
+  }
+
   uint8_t cmd[3] = { PN5180_LOAD_RF_CONFIG, txConf, rxConf };
 
-  SPI.beginTransaction(SPI_SETTINGS);
-  transceiveCommand(cmd, 3);
-  SPI.endTransaction();
+  hal->beginTransaction();
+  bool success = transceiveCommand(cmd, 3);
+  hal->endTransaction();
 
-  return true;
+  // the RF configuration overwrites the CRC and other registers
+  invalidateRegisterCache();
+  if (success) {
+    if (0xff != txConf) rfTxConfig = txConf;
+    if (0xff != rxConf) rfRxConfig = rxConf;
+  }
+  return success;
 }
 
 /*
@@ -480,11 +965,16 @@ bool PN5180::setRF_on() {
 
   uint8_t cmd[2] = { PN5180_RF_ON, 0x00 };
 
-  SPI.beginTransaction(SPI_SETTINGS);
+  hal->beginTransaction();
   transceiveCommand(cmd, 2);
-  SPI.endTransaction();
+  hal->endTransaction();
 
-  while (0 == (TX_RFON_IRQ_STAT & getIRQStatus())); // wait for RF field to set up
+  // wait for RF field to set up
+  if (0 == (TX_RFON_IRQ_STAT & waitForIRQ(TX_RFON_IRQ_STAT, 1000UL * commandTimeout))) {
+    PN5180DEBUG(F("*** ERROR: Timeout in setRF_on!\n"));
+    return false;
+  }
+  rfOn = true;
   clearIRQStatus(TX_RFON_IRQ_STAT);
   return true;
 }
@@ -499,15 +989,28 @@ bool PN5180::setRF_off() {
 
   uint8_t cmd[2] { PN5180_RF_OFF, 0x00 };
 
-  SPI.beginTransaction(SPI_SETTINGS);
+  hal->beginTransaction();
   transceiveCommand(cmd, 2);
-  SPI.endTransaction();
+  hal->endTransaction();
+  rfOn = false;
 
-  while (0 == (TX_RFOFF_IRQ_STAT & getIRQStatus())); // wait for RF field to shut down
+  // wait for RF field to shut down
+  if (0 == (TX_RFOFF_IRQ_STAT & waitForIRQ(TX_RFOFF_IRQ_STAT, 1000UL * commandTimeout))) {
+    PN5180DEBUG(F("*** ERROR: Timeout in setRF_off!\n"));
+    return false;
+  }
   clearIRQStatus(TX_RFOFF_IRQ_STAT);
   return true;
 }
 
+/*
+ * RF field state as switched by setRF_on()/setRF_off(), reset() and LPCD
+ * switch the field off
+ */
+bool PN5180::isRF_on() {
+  return rfOn;
+}
+
 //---------------------------------------------------------------------------------------------
 
 /*
@@ -547,69 +1050,72 @@ status register contain information on the exception.
  * If there is a parameter error, the IRQ is set to ACTIVE and a GENERAL_ERROR_IRQ is set.
  */
 bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_t *recvBuffer, size_t recvBufferLen) {
+  return transceiveCommand(sendBuffer, sendBufferLen, 0, 0, recvBuffer, recvBufferLen);
+}
+
+/*
+ * Same as above, the SPI frame is gathered from the command header and
+ * an optional payload (e.g. the caller's data of SEND_DATA)
+ */
+bool PN5180::transceiveCommand(uint8_t *header, size_t headerLen, uint8_t *payload, size_t payloadLen,
+                               uint8_t *recvBuffer, size_t recvBufferLen) {
 #ifdef DEBUG
   PN5180DEBUG(F("Sending SPI frame: '"));
-  for (uint8_t i=0; i<sendBufferLen; i++) {
-    if (i>0) PN5180DEBUG(" ");
-    PN5180DEBUG(formatHex(sendBuffer[i]));
+  PN5180DEBUG_HEX(header, headerLen);
+  if (payloadLen > 0) {
+    PN5180DEBUG(" ");
+    PN5180DEBUG_HEX(payload, payloadLen);
   }
   PN5180DEBUG("'\n");
 #endif
 
+  // send queued register writes first
+  if (registerBatchCount > 0 && header != registerBatch) {
+    if (!flushRegisterBatch()) return false;
+  }
+
+  PN5180STATS(PN5180StatsTimer timer(hal, (header[0] < PN5180_STATS_COMMANDS) ? &stats.command[header[0]] : 0));
   // 0.
-  unsigned long startedWaiting = millis();
-  while (LOW != digitalRead(PN5180_BUSY)) {
-    if (millis() - startedWaiting > commandTimeout) return false;
-  }; // wait until busy is low
+  if (!waitForBusy(LOW)) return false; // wait until busy is low
   // 1.
-  digitalWrite(PN5180_NSS, LOW); delay(1);
+  hal->writePin(PN5180_NSS, LOW);
+  if (nssSetupTime) hal->delayUs(nssSetupTime);
   // 2.
-  for (uint8_t i=0; i<sendBufferLen; i++) {
-    SPI.transfer(sendBuffer[i]);
-  }
+  spiWrite(header, headerLen);
+  if (payloadLen > 0) spiWrite(payload, payloadLen);
+  PN5180TRACE(PN5180_TRACE_SPI_SEND, PN5180_NSS, header, headerLen, payload, payloadLen);
   // 3.
-  startedWaiting = millis();
-  while (HIGH != digitalRead(PN5180_BUSY)) {
-    if (millis() - startedWaiting > commandTimeout) return false;
-  }; // wait until busy is high
+  if (!waitForBusy(HIGH)) return false; // wait until busy is high
   // 4.
-  digitalWrite(PN5180_NSS, HIGH); delay(1);
+  hal->writePin(PN5180_NSS, HIGH);
   // 5.
-  startedWaiting = millis();
-  while (LOW != digitalRead(PN5180_BUSY)) {
-    if (millis() - startedWaiting > commandTimeout) return false;
-  }; // wait until busy is low
+  if (!waitForBusy(LOW)) return false; // wait until busy is low
 
   // check, if write-only
   //
-  if ((0 == recvBuffer) || (0 == recvBufferLen)) return true;
+  if ((0 == recvBuffer) || (0 == recvBufferLen)) {
+    PN5180STATS(timer.success = true);
+    return true;
+  }
   PN5180DEBUG(F("Receiving SPI frame...\n"));
 
   // 1.
-  digitalWrite(PN5180_NSS, LOW); delay(1);
+  hal->writePin(PN5180_NSS, LOW);
+  if (nssSetupTime) hal->delayUs(nssSetupTime);
   // 2.
-  for (uint8_t i=0; i<recvBufferLen; i++) {
-    recvBuffer[i] = SPI.transfer(0xff);
-  }
+  spiRead(recvBuffer, recvBufferLen);
+  PN5180TRACE(PN5180_TRACE_SPI_RECEIVE, PN5180_NSS, recvBuffer, recvBufferLen);
   // 3.
-  startedWaiting = millis();
-  while (HIGH != digitalRead(PN5180_BUSY)) {
-    if (millis() - startedWaiting > commandTimeout) return false;
-  }; // wait until busy is high
+  if (!waitForBusy(HIGH)) return false; // wait until busy is high
   // 4.
-  digitalWrite(PN5180_NSS, HIGH); 
+  hal->writePin(PN5180_NSS, HIGH); 
   // 5.
-  startedWaiting = millis();
-  while (LOW != digitalRead(PN5180_BUSY)) {
-    if (millis() - startedWaiting > commandTimeout) return false;
-  }; // wait until busy is low
+  if (!waitForBusy(LOW)) return false; // wait until busy is low
+  PN5180STATS(timer.success = true);
 
 #ifdef DEBUG
-  PN5180DEBUG(F("Received: "));
-  for (uint8_t i=0; i<recvBufferLen; i++) {
-    if (i > 0) PN5180DEBUG(" ");
-    PN5180DEBUG(formatHex(recvBuffer[i]));
-  }
+  PN5180DEBUG(F("Received: '"));
+  PN5180DEBUG_HEX(recvBuffer, recvBufferLen);
   PN5180DEBUG("'\n");
 #endif
 
@@ -617,17 +1123,166 @@ bool PN5180::transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_
 }
 
 /*
- * Reset NFC device
+ * Wait until the BUSY line has the given level, false after commandTimeout ms
+ */
+bool PN5180::waitForBusy(uint8_t level) {
+  PN5180STATS(unsigned long busyStart = hal->getMicros());
+  unsigned long startedWaiting = hal->getMillis();
+#ifdef PN5180_FREERTOS
+  unsigned long spinStart = hal->getMicros();
+#endif
+  while (level != hal->readPin(PN5180_BUSY)) {
+    if (hal->getMillis() - startedWaiting > commandTimeout) {
+      PN5180STATS(stats.busyWaitUs += hal->getMicros() - busyStart);
+      PN5180STATS(stats.busyTimeouts++);
+      return false;
+    }
+#ifdef PN5180_FREERTOS
+    // long operations (e.g. EEPROM writes) let lower priority tasks run
+    if (hal->getMicros() - spinStart >= PN5180_FREERTOS_SPIN_US) vTaskDelay(1);
+#endif
+  }
+  PN5180STATS(stats.busyWaitUs += hal->getMicros() - busyStart);
+  return true;
+}
+
+/*
+ * Reserve the bus for a sequence of commands, e.g. an activation and the
+ * following reads, so other tasks sharing the bus (see PN5180FreeRTOSHAL)
+ * cannot interleave their transfers. Calls can be nested, false on timeout.
+ */
+bool PN5180::lockBus(uint32_t timeoutMs) {
+  return hal->lockBus(timeoutMs);
+}
+
+void PN5180::unlockBus() {
+  hal->unlockBus();
+}
+
+/*
+ * Copy of the statistics collected since the last resetStats(), with avgUs
+ * calculated. Returns false (and a zeroed snapshot) if the library is built
+ * without PN5180_STATS.
  */
-void PN5180::reset() {
-  digitalWrite(PN5180_RST, LOW);  // at least 10us required
-  delayMicroseconds(10);
-  digitalWrite(PN5180_RST, HIGH); // 2ms to ramp up required
-  delay(2);
+bool PN5180::getStats(PN5180Stats *snapshot) {
+#ifdef PN5180_STATS
+  *snapshot = stats;
+  for (uint8_t i = 0; i < PN5180_STATS_COMMANDS; i++) {
+    PN5180TimingStats &s = snapshot->command[i];
+    s.avgUs = s.count ? (s.totalUs / s.count) : 0;
+  }
+  PN5180TimingStats *rf[2] = { &snapshot->iso15693Command, &snapshot->activateTypeA };
+  for (uint8_t i = 0; i < 2; i++) {
+    rf[i]->avgUs = rf[i]->count ? (rf[i]->totalUs / rf[i]->count) : 0;
+  }
+  return true;
+#else
+  memset(snapshot, 0, sizeof(PN5180Stats));
+  return false;
+#endif
+}
 
-  while (0 == (IDLE_IRQ_STAT & getIRQStatus())); // wait for system to start up
+void PN5180::resetStats() {
+  PN5180STATS(memset(&stats, 0, sizeof(stats)));
+}
+
+/*
+ * SPI clock of the host interface, used from the next command on.
+ * Long cables or level shifters may require less than the max. 7 Mbps.
+ */
+void PN5180::setSPIClock(uint32_t clock) {
+  spiClock = clock;
+  hal->setSPIClock(spiClock);
+}
 
-  clearIRQStatus(0xffffffff); // clear all flags
+uint32_t PN5180::getSPIClock() {
+  return spiClock;
+}
+
+/*
+ * Find the fastest stable SPI clock for the actual wiring, call after begin()
+ * and reset(). The version block of the EEPROM (PRODUCT_VERSION..EEPROM_VERSION)
+ * is read at PN5180_SPI_CLOCK_MIN as reference, then the clock is increased
+ * in 1MHz steps up to maxClock while the block is read back unchanged several
+ * times. The last clock without errors is set and returned.
+ * Returns 0 if even the reference read fails, the clock is not changed then.
+ */
+uint32_t PN5180::calibrateSPIClock(uint32_t maxClock) {
+  const uint8_t repeat = 8;
+  uint32_t previousClock = spiClock;
+  uint8_t reference[6];
+  uint8_t version[6];
+
+  setSPIClock(PN5180_SPI_CLOCK_MIN);
+  if (!readEEprom(PRODUCT_VERSION, reference, sizeof(reference)) ||
+      (0xff == reference[1]) || (0x00 == reference[1])) { // major version
+    PN5180DEBUG(F("*** ERROR: SPI reference read failed!\n"));
+    setSPIClock(previousClock);
+    return 0;
+  }
+
+  uint32_t stableClock = PN5180_SPI_CLOCK_MIN;
+  for (uint32_t clock = PN5180_SPI_CLOCK_MIN + 1000000UL; clock <= maxClock; clock += 1000000UL) {
+    setSPIClock(clock);
+    bool stable = true;
+    for (uint8_t i=0; stable && i<repeat; i++) {
+      stable = readEEprom(PRODUCT_VERSION, version, sizeof(version)) &&
+               (0 == memcmp(reference, version, sizeof(version)));
+    }
+    if (!stable) break;
+    stableClock = clock;
+  }
+
+  PN5180DEBUG(F("SPI clock calibrated to "));
+  PN5180DEBUG(stableClock);
+  PN5180DEBUG(F("Hz\n"));
+
+  setSPIClock(stableClock);
+  return stableClock;
+}
+
+/*
+ * Bulk SPI transfers of transceiveCommand, called within an SPI transaction.
+ * Received frames are read in place, the buffer is prefilled with 0xff.
+ */
+void PN5180::spiWrite(uint8_t *data, size_t len) {
+  PN5180STATS(stats.spiBytesSent += len);
+  hal->spiWrite(data, len);
+}
+
+void PN5180::spiRead(uint8_t *buffer, size_t len) {
+  PN5180STATS(stats.spiBytesReceived += len);
+  memset(buffer, 0xff, len);
+  hal->spiRead(buffer, len);
+}
+
+/*
+ * Reset NFC device
+ */
+bool PN5180::reset() {
+  hal->writePin(PN5180_RST, LOW);  // at least 10us required
+  hal->delayUs(10);
+  hal->writePin(PN5180_RST, HIGH); // boot takes ~2ms, polled below
+
+  irqEnable = 0; // IRQ_ENABLE is cleared by reset
+  invalidateRegisterCache();
+  registerBatchCount = 0; // queued writes are obsolete
+  rfOn = false;
+
+  // wait for system to start up, signalled by IDLE_IRQ. While booting, the
+  // PN5180 holds BUSY high or the registers read as 0xffffffff
+  unsigned long started = hal->getMicros();
+  uint32_t timeoutUs = 1000UL * commandTimeout;
+  do {
+    uint32_t irqStatus;
+    if (readRegister(IRQ_STATUS, &irqStatus) &&
+        (0xffffffff != irqStatus) && (irqStatus & IDLE_IRQ_STAT)) {
+      return clearIRQStatus(0xffffffff); // clear all flags
+    }
+  } while (hal->getMicros() - started < timeoutUs);
+
+  PN5180DEBUG(F("*** ERROR: Timeout waiting for PN5180 start up!\n"));
+  return false;
 }
 
 /**
@@ -637,7 +1292,7 @@ void PN5180::reset() {
 uint32_t PN5180::getIRQStatus() {
   PN5180DEBUG(F("Read IRQ-Status register...\n"));
 
-  uint32_t irqStatus;
+  uint32_t irqStatus = 0;
   readRegister(IRQ_STATUS, &irqStatus);
 
   PN5180DEBUG(F("IRQ-Status=0x"));
@@ -655,6 +1310,120 @@ bool PN5180::clearIRQStatus(uint32_t irqMask) {
   return writeRegister(IRQ_CLEAR, irqMask);
 }
 
+/*
+ * Wait until at least one of the flags in irqMask is set in IRQ_STATUS.
+ * Returns the last IRQ status read. If none of the flags of irqMask is
+ * set in the returned value, the wait timed out.
+ * With an IRQ pin, only the flags of irqMask are enabled in IRQ_ENABLE and
+ * IRQ_STATUS is only read after the IRQ line was asserted. Until then, no SPI traffic
+ * is generated and other tasks may run.
+ */
+uint32_t PN5180::waitForIRQ(uint32_t irqMask, uint32_t timeoutUs) {
+  enableIRQ(irqMask);
+#ifdef PN5180_FREERTOS
+  // the IRQ handler wakes this task, a notification of an earlier wait is discarded
+  if (irqSlot >= 0) {
+    ulTaskNotifyTake(pdTRUE, 0);
+    irqTasks[irqSlot] = xTaskGetCurrentTaskHandle();
+  }
+#endif
+
+  unsigned long startedWaiting = hal->getMicros();
+  uint32_t irqStatus = 0;
+  bool timedOut = false;
+  do {
+    if (irqSlot >= 0) {
+      while (!irqPending()) {
+        uint32_t elapsed = hal->getMicros() - startedWaiting;
+        if (elapsed >= timeoutUs) {
+          timedOut = true;
+          break;
+        }
+#ifdef PN5180_FREERTOS
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((timeoutUs - elapsed) / 1000) + 1);
+#else
+        yield();
+#endif
+      }
+      if (timedOut) break;
+    }
+    irqStatus = getIRQStatus();
+    if (irqStatus & irqMask) break;
+#ifdef PN5180_FREERTOS
+    if ((irqSlot < 0) && (hal->getMicros() - startedWaiting >= PN5180_FREERTOS_SPIN_US)) vTaskDelay(1);
+#endif
+  } while (hal->getMicros() - startedWaiting < timeoutUs);
+
+#ifdef PN5180_FREERTOS
+  if (irqSlot >= 0) irqTasks[irqSlot] = 0;
+#endif
+  return irqStatus;
+}
+
+/*
+ * Forget the cached RF configuration and register values. The next
+ * loadRFConfig() and register mask writes are sent unconditionally.
+ */
+void PN5180::invalidateRegisterCache() {
+  rfTxConfig = 0xff;
+  rfRxConfig = 0xff;
+  for (int i=0; i<3; i++) {
+    shadowValue[i] = 0;
+    shadowKnown[i] = 0;
+  }
+}
+
+/*
+ * Registers with a shadow copy, to skip mask writes which would not change
+ * anything. Only registers solely written by the host are shadowed.
+ */
+int8_t PN5180::shadowIndex(uint8_t reg) {
+  switch (reg) {
+    case SYSTEM_CONFIG: return 0;
+    case CRC_RX_CONFIG: return 1;
+    case CRC_TX_CONFIG: return 2;
+    default: return -1;
+  }
+}
+
+/*
+ * Enable only the flags of irqMask for the IRQ pin, if connected, so that
+ * flags handled before do not keep the IRQ line asserted. The write is sent
+ * at once, also within a register batch (the queue is sent before it).
+ */
+void PN5180::enableIRQ(uint32_t irqMask) {
+  if (irqSlot < 0 || irqEnable == irqMask) {
+    return;
+  }
+  uint8_t buf[6] = { PN5180_WRITE_REGISTER, IRQ_ENABLE, (uint8_t)irqMask, (uint8_t)(irqMask >> 8),
+                     (uint8_t)(irqMask >> 16), (uint8_t)(irqMask >> 24) };
+  hal->beginTransaction();
+  if (transceiveCommand(buf, 6)) {
+    irqEnable = irqMask;
+  }
+  hal->endTransaction();
+}
+
+/*
+ * State of the IRQ line, read without SPI access, so it can be checked
+ * while the PN5180 is in LPCD or standby. False if no IRQ pin is connected.
+ */
+bool PN5180::isIRQAsserted() {
+  return hasIRQPin() && (HIGH == hal->readPin(PN5180_IRQ));
+}
+
+/*
+ * Check and reset the IRQ event flag set by the interrupt handler. The IRQ
+ * line is level triggered, so an IRQ still asserted is pending as well.
+ */
+bool PN5180::irqPending() {
+  if (irqFlags[irqSlot]) {
+    irqFlags[irqSlot] = false;
+    return true;
+  }
+  return (HIGH == hal->readPin(PN5180_IRQ));
+}
+
 /*
  * Get TRANSCEIVE_STATE from RF_STATUS register
  */
@@ -692,3 +1461,88 @@ PN5180TransceiveStat PN5180::getTransceiveState() {
 
   return PN5180TransceiveStat(state);
 }
+
+/*
+ * Start a non-blocking transceive: send data to the card and return
+ * immediately. The reception is driven by calling poll() until the
+ * transceive is finished, e.g. from loop(). poll() moves through the
+ * transceive states
+ *   PN5180_TS_WaitReceive - data sent, waiting for the card's answer
+ *   PN5180_TS_Receiving   - start of frame detected (polling mode only)
+ *   PN5180_TS_Idle        - finished, onComplete has been called
+ * The response is written to rxBuffer. If the card does not answer within
+ * timeoutUs, onComplete is called with success=false.
+ */
+bool PN5180::startTransceive(uint8_t *data, int len, uint8_t validBits,
+                             uint8_t *rxBuffer, uint16_t rxBufferSize, uint32_t timeoutUs,
+                             PN5180TransceiveCallback onComplete, void *arg) {
+  if (PN5180_TS_Idle != asyncState) {
+    PN5180DEBUG(F("*** ERROR: Transceive already active!\n"));
+    return false;
+  }
+
+  asyncRxBuffer = rxBuffer;
+  asyncRxBufferSize = rxBufferSize;
+  asyncTimeout = timeoutUs;
+  asyncCallback = onComplete;
+  asyncCallbackArg = arg;
+
+  enableIRQ(RX_IRQ_STAT);
+  clearIRQStatus(RX_IRQ_STAT | RX_SOF_DET_IRQ_STAT);
+  if (!sendData(data, len, validBits)) {
+    return false;
+  }
+
+  asyncStarted = hal->getMicros();
+  asyncState = PN5180_TS_WaitReceive;
+  return true;
+}
+
+/*
+ * Drive the non-blocking transceive started with startTransceive().
+ * Returns the current transceive state, PN5180_TS_Idle when finished.
+ * With an IRQ pin, no SPI traffic is generated until the IRQ line is
+ * asserted.
+ */
+PN5180TransceiveStat PN5180::poll() {
+  if (PN5180_TS_Idle == asyncState) {
+    return PN5180_TS_Idle;
+  }
+
+  bool timedOut = (hal->getMicros() - asyncStarted >= asyncTimeout);
+  if (irqSlot >= 0 && !timedOut && !irqPending()) {
+    return asyncState;
+  }
+
+  uint32_t irqStatus = getIRQStatus();
+  if (irqStatus & RX_IRQ_STAT) {
+    uint32_t rxStatus;
+    readRegister(RX_STATUS, &rxStatus);
+    uint16_t len = (uint16_t)(rxStatus & 0x000001ff);
+    if (len > asyncRxBufferSize) {
+      PN5180DEBUG(F("*** ERROR: Receive buffer too small!\n"));
+      finishTransceive(false, 0);
+    }
+    else {
+      bool success = readData(len, asyncRxBuffer);
+      clearIRQStatus(RX_IRQ_STAT | RX_SOF_DET_IRQ_STAT);
+      finishTransceive(success, len);
+    }
+  }
+  else if (timedOut) {
+    PN5180DEBUG(F("Transceive timeout\n"));
+    finishTransceive(false, 0);
+  }
+  else if (irqStatus & RX_SOF_DET_IRQ_STAT) {
+    asyncState = PN5180_TS_Receiving;
+  }
+
+  return asyncState;
+}
+
+void PN5180::finishTransceive(bool success, uint16_t len) {
+  asyncState = PN5180_TS_Idle;
+  if (asyncCallback) {
+    asyncCallback(this, success, asyncRxBuffer, len, asyncCallbackArg);
+  }
+}
@@ -20,6 +20,8 @@
 #define PN5180_H
 
 #include <SPI.h>
+#include "PN5180HAL.h"
+#include "PN5180Stats.h"
 
 // PN5180 Registers
 #define SYSTEM_CONFIG       (0x00)
@@ -47,6 +49,37 @@
 #define FIRMWARE_VERSION    (0x12)
 #define EEPROM_VERSION      (0x14)
 #define IRQ_PIN_CONFIG      (0x1A)
+#define LPCD_REFERENCE_VALUE (0x34)
+#define LPCD_FIELD_ON_TIME  (0x36)
+#define LPCD_THRESHOLD      (0x37)
+#define LPCD_REFVAL_GPO_CONTROL (0x38)
+
+// SYSTEM_CONFIG
+#define MFC_CRYPTO_ON       (1<<6)  // MIFARE Classic Crypto1 enabled
+
+// MIFARE Classic key types and results of mifareAuthenticate()
+#define MIFARE_KEY_A        (0x60)
+#define MIFARE_KEY_B        (0x61)
+#define MIFARE_AUTH_OK      (0x00)
+#define MIFARE_AUTH_DENIED  (0x01) // wrong key
+#define MIFARE_AUTH_TIMEOUT (0x02) // no answer of the card
+#define MIFARE_AUTH_ERROR   (0xff) // SPI error
+
+// AGC value in AGC_REF_CONFIG
+#define AGC_VALUE_MASK      (0x000003ff)
+
+// LPCD modes of LPCD_REFVAL_GPO_CONTROL
+#define PN5180_LPCD_AUTO_CALIBRATION (0x00) // reference from LPCD_REFERENCE_VALUE
+#define PN5180_LPCD_SELF_CALIBRATION (0x01) // reference measured when entering LPCD
+// LPCD field on time in us for LPCD_FIELD_ON_TIME value
+#define PN5180_LPCD_FIELD_ON_TIME_US(value) (62UL + 8UL * (value))
+// typical currents used by lpcdAverageCurrent(), depend on antenna and supply
+#ifndef PN5180_LPCD_FIELD_CURRENT_UA
+#define PN5180_LPCD_FIELD_CURRENT_UA 100000UL
+#endif
+#ifndef PN5180_LPCD_STANDBY_CURRENT_UA
+#define PN5180_LPCD_STANDBY_CURRENT_UA 10UL
+#endif
 
 enum PN5180TransceiveStat {
   PN5180_TS_Idle = 0,
@@ -68,24 +101,123 @@ enum PN5180TransceiveStat {
 #define TX_RFOFF_IRQ_STAT   	(1<<8)  // RF Field OFF in PCD IRQ
 #define TX_RFON_IRQ_STAT    	(1<<9)  // RF Field ON in PCD IRQ
 #define RX_SOF_DET_IRQ_STAT 	(1<<14) // RF SOF Detection IRQ
+#ifndef TEMPSENS_ERROR_IRQ_STAT
+#define TEMPSENS_ERROR_IRQ_STAT 	(1<<16) // Temperature sensor, overtemperature detected
+#endif
 #define GENERAL_ERROR_IRQ_STAT 	(1<<17) // General error IRQ
 #define LPCD_IRQ_STAT 			(1<<19) // LPCD Detection IRQ
 
+// PN5180 RX_STATUS
+#define RX_BYTES_RECEIVED_MASK  	(0x000001ff) // Number of bytes received
+#define RX_DATA_INTEGRITY_ERROR 	(1<<16) // CRC or parity error
+#define RX_PROTOCOL_ERROR       	(1<<17) // Protocol error
+#define RX_COLLISION_DETECTED   	(1<<18) // Collision detected
+#define RX_COLL_POS_SHIFT       	19      // Position of first collision bit
+#define RX_COLL_POS_MASK        	(0x7f<<RX_COLL_POS_SHIFT)
+
+// size of the RF reception buffer of the PN5180
+#define PN5180_RX_BUFFER_MAX	508
+// size of the receive buffer used by readData(len), shared by the instances
+// without their own buffer (setReadBuffer). Set it as build flag, e.g. to 64
+// for applications reading short frames only, it is used in PN5180.cpp only.
+#ifndef PN5180_READ_BUFFER_SIZE
+#define PN5180_READ_BUFFER_SIZE	PN5180_RX_BUFFER_MAX
+#endif
+// at least one ISO15693 block of 32 bytes with flags and 14443-4 frames of 32 bytes
+#define PN5180_READ_BUFFER_MIN	40
+#if (PN5180_READ_BUFFER_SIZE < PN5180_READ_BUFFER_MIN) || (PN5180_READ_BUFFER_SIZE > PN5180_RX_BUFFER_MAX)
+#error "PN5180_READ_BUFFER_SIZE must be in the range 40..508"
+#endif
+
+// SPI clock of the PN5180 host interface, max. 7 Mbps
+#ifndef PN5180_SPI_CLOCK
+#define PN5180_SPI_CLOCK 7000000UL
+#endif
+// clock used as reference by calibrateSPIClock()
+#define PN5180_SPI_CLOCK_MIN 1000000UL
+
+// max. number of register writes combined by beginRegisterBatch()
+#ifndef PN5180_REGISTER_BATCH_SIZE
+#define PN5180_REGISTER_BATCH_SIZE	8
+#endif
+
+// IRQ pin not connected, wait for IRQs by polling IRQ_STATUS
+#define PN5180_NO_IRQ_PIN		(0xff)
+// max. number of PN5180 instances with IRQ pin
+#define PN5180_MAX_IRQ_PINS		4
+
+class PN5180;
+
+/*
+ * Called by PN5180::poll() when a non-blocking transceive has finished.
+ * On success, data points to the receive buffer given to startTransceive()
+ * and len is the number of bytes received.
+ */
+typedef void (*PN5180TransceiveCallback)(PN5180 *reader, bool success, uint8_t *data, uint16_t len, void *arg);
+// called by checkPresence(), if the tracked card was removed
+typedef void (*PN5180CardRemovedCallback)(const uint8_t *uid, uint8_t uidLength, void *arg);
+
 class PN5180 {
 private:
   uint8_t PN5180_NSS;   // active low
   uint8_t PN5180_BUSY;
   uint8_t PN5180_RST;
+  uint8_t PN5180_IRQ;   // active high, optional
+
+  PN5180ArduinoHAL arduinoHAL;
+  PN5180HAL *hal;       // arduinoHAL or the HAL given to the constructor
+  uint32_t spiClock;
+  uint8_t *readBuffer;  // buffer of readData(len)
+  uint16_t readBufferSize;
+
+  // last RF configuration loaded by loadRFConfig(), 0xff = unknown
+  uint8_t rfTxConfig;
+  uint8_t rfRxConfig;
+  // shadow of SYSTEM_CONFIG, CRC_RX_CONFIG and CRC_TX_CONFIG, see shadowIndex()
+  uint32_t shadowValue[3];
+  uint32_t shadowKnown[3]; // bits with known value
+
+  // register writes queued for WRITE_REGISTER_MULTIPLE
+  uint8_t registerBatch[1 + 6*PN5180_REGISTER_BATCH_SIZE];
+  uint8_t registerBatchCount;
+  uint8_t registerBatchDepth;
+
+  int8_t irqSlot;       // slot of the interrupt handler, -1 if none
+  uint32_t irqEnable;   // current value of IRQ_ENABLE register
 
-  SPISettings SPI_SETTINGS;
-  static uint8_t readBuffer[508];
+  bool rfOn;            // RF field switched on by setRF_on()
+
+  // LPCD configuration, see calibrateLPCD()
+  uint16_t lpcdReference;
+  uint8_t lpcdThreshold;
+  bool lpcdConfigLoaded; // values above read from EEPROM or calibrated
+
+  // state of the non-blocking transceive
+  PN5180TransceiveStat asyncState;
+  uint8_t *asyncRxBuffer;
+  uint16_t asyncRxBufferSize;
+  unsigned long asyncStarted;
+  uint32_t asyncTimeout;
+  PN5180TransceiveCallback asyncCallback;
+  void *asyncCallbackArg;
+
+#ifdef PN5180_STATS
+protected:
+  // updated by the protocol classes too, see PN5180Stats.h
+  PN5180Stats stats;
+#endif
 
 public:
-  PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin);
+  PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi = SPI);
+  PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi = SPI);
+  PN5180(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal);
 
   void begin();
   void end();
 
+  // platform interface given to the constructor or the Arduino default
+  PN5180HAL *getHAL() { return hal; }
+
   /*
    * PN5180 direct commands with host interface
    */
@@ -96,6 +228,9 @@ public:
   bool writeRegisterWithOrMask(uint8_t addr, uint32_t mask);
   /* cmd 0x02 */
   bool writeRegisterWithAndMask(uint8_t addr, uint32_t mask);
+  /* cmd 0x03, combines the register writes of cmd 0x00-0x02 */
+  void beginRegisterBatch();
+  bool endRegisterBatch();
 
   /* cmd 0x04 */
   bool readRegister(uint8_t reg, uint32_t *value);
@@ -104,16 +239,34 @@ public:
   bool writeEEprom(uint8_t addr, uint8_t *buffer, uint8_t len);
   /* cmd 0x07 */
   bool readEEprom(uint8_t addr, uint8_t *buffer, int len);
+  /* cmd 0x07 + 0x06, writes differing bytes only */
+  bool updateEEprom(uint8_t addr, uint8_t *buffer, uint8_t len);
 
   /* cmd 0x09 */
   bool sendData(uint8_t *data, int len, uint8_t validBits = 0);
+  bool sendDataFast(uint8_t *data, int len, uint8_t validBits = 0);
+  bool sendDataFrame(uint8_t *frame, int frameLen, uint8_t *data = 0, int len = 0);
   /* cmd 0x0a */
   uint8_t * readData(int len);
-  bool readData(uint8_t len, uint8_t *buffer);
+  bool readData(uint16_t len, uint8_t *buffer);
+  void setReadBuffer(uint8_t *buffer, uint16_t size);
+  uint16_t getReadBufferSize();
   /* prepare LPCD registers */
   bool prepareLPCD();
+  bool prepareLPCD(uint8_t fieldOnTime, uint8_t threshold, uint8_t mode);
+  bool calibrateLPCD(uint8_t fieldOnTime = 0xF0, uint8_t mode = PN5180_LPCD_SELF_CALIBRATION, uint8_t samples = 16);
+  uint16_t getLPCDReference();
+  uint8_t getLPCDThreshold();
+  bool readAGC(uint16_t *agc);
+  bool getLPCDAGCDelta(int16_t *delta);
+  static uint32_t lpcdDutyCycle(uint8_t fieldOnTime, uint16_t wakeupCounterInMs);
+  static uint32_t lpcdAverageCurrent(uint8_t fieldOnTime, uint16_t wakeupCounterInMs,
+                                     uint32_t fieldCurrentUa = PN5180_LPCD_FIELD_CURRENT_UA,
+                                     uint32_t standbyCurrentUa = PN5180_LPCD_STANDBY_CURRENT_UA);
   /* cmd 0x0B */
   bool switchToLPCD(uint16_t wakeupCounterInMs);
+  /* cmd 0x0C */
+  uint8_t mifareAuthenticate(uint8_t blockNo, const uint8_t *key, uint8_t keyType, const uint8_t *uid);
   /* cmd 0x11 */
   bool loadRFConfig(uint8_t txConf, uint8_t rxConf);
 
@@ -121,24 +274,70 @@ public:
   bool setRF_on();
   /* cmd 0x17 */
   bool setRF_off();
+  bool isRF_on();
 
   /*
    * Helper functions
    */
 public:
-  void reset();
+  bool reset();
 
   uint8_t commandTimeout = 50;
+  /*
+   * Time in us between asserting NSS and the first SPI clock. The datasheet
+   * only requires a few ns here, the BUSY line handles all other timing.
+   * Increase for slow level shifters or long cables.
+   */
+  uint16_t nssSetupTime = 1;
   uint32_t getIRQStatus();
   bool clearIRQStatus(uint32_t irqMask);
+  uint32_t waitForIRQ(uint32_t irqMask, uint32_t timeoutUs);
+  bool hasIRQPin() { return (PN5180_NO_IRQ_PIN != PN5180_IRQ); }
+  bool isIRQAsserted();
 
   PN5180TransceiveStat getTransceiveState();
 
+  void invalidateRegisterCache();
+
+  void setSPIClock(uint32_t clock);
+  uint32_t getSPIClock();
+  uint32_t calibrateSPIClock(uint32_t maxClock = PN5180_SPI_CLOCK);
+
+  bool lockBus(uint32_t timeoutMs = 0xffffffff);
+  void unlockBus();
+
+  bool getStats(PN5180Stats *snapshot);
+  void resetStats();
+
+  /*
+   * Non-blocking transceive, see startTransceive()
+   */
+public:
+  bool startTransceive(uint8_t *data, int len, uint8_t validBits,
+                       uint8_t *rxBuffer, uint16_t rxBufferSize, uint32_t timeoutUs,
+                       PN5180TransceiveCallback onComplete = 0, void *arg = 0);
+  PN5180TransceiveStat poll();
+  bool isTransceiveActive() { return (PN5180_TS_Idle != asyncState); }
+  bool isBusy() { return (HIGH == hal->readPin(PN5180_BUSY)); }
+
   /*
    * Private methods, called within an SPI transaction
    */
 private:
+  int8_t shadowIndex(uint8_t reg);
+  bool queueRegisterWrite(uint8_t reg, uint8_t action, uint32_t value);
+  bool flushRegisterBatch();
+  void enableIRQ(uint32_t irqMask);
+  void finishTransceive(bool success, uint16_t len);
+  bool irqPending();
+  bool loadLPCDConfig();
+  bool startTransceiveCycle();
   bool transceiveCommand(uint8_t *sendBuffer, size_t sendBufferLen, uint8_t *recvBuffer = 0, size_t recvBufferLen = 0);
+  bool transceiveCommand(uint8_t *header, size_t headerLen, uint8_t *payload, size_t payloadLen,
+                         uint8_t *recvBuffer, size_t recvBufferLen);
+  bool waitForBusy(uint8_t level);
+  void spiWrite(uint8_t *data, size_t len);
+  void spiRead(uint8_t *buffer, size_t len);
 
 };
 
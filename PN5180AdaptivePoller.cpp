@@ -0,0 +1,208 @@
+// NAME: PN5180AdaptivePoller.cpp
+//
+// DESC: Polling scheduler for PN5180Discovery: backs off the poll interval
+//       while no tag is present, switches the RF field off between polls
+//       and uses LPCD when idle for long, limits the RF duty cycle.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180AdaptivePoller.h"
+#include "Debug.h"
+
+PN5180AdaptivePoller::PN5180AdaptivePoller(PN5180Discovery &reader) : reader(reader) {
+  begin();
+}
+
+/*
+ * Restart in idle state, the next poll() polls immediately
+ */
+void PN5180AdaptivePoller::begin() {
+  state = PN5180_POLLER_IDLE;
+  interval = minInterval;
+  lastPoll = reader.getHAL()->getMillis() - interval;
+  stateStarted = reader.getHAL()->getMillis();
+  emptyPolls = 0;
+  dutyCycle = 0;
+  fieldOffPending = false;
+}
+
+/*
+ * Polls the technologies if the interval has elapsed, the PN5180 has left
+ * LPCD or the cooldown is over. Returns PN5180_TECH_NONE if no poll was
+ * due or no tag answered.
+ */
+PN5180Technology PN5180AdaptivePoller::poll(uint8_t *uid, uint8_t *uidLength, uint8_t technologies) {
+  unsigned long now = reader.getHAL()->getMillis();
+  bool due = (now - lastPoll >= interval);
+
+  if (PN5180_POLLER_LPCD == state) {
+    // no SPI access, it would end LPCD
+    if (!reader.isIRQAsserted() || !leaveLPCD())
+      return PN5180_TECH_NONE;
+    due = true;
+  }
+  else if (PN5180_POLLER_COOLDOWN == state) {
+    if (now - stateStarted < cooldownTime)
+      return PN5180_TECH_NONE;
+    PN5180DEBUG(F("Poller: cooldown finished\n"));
+    reader.clearIRQStatus(TEMPSENS_ERROR_IRQ_STAT);
+    enterState(PN5180_POLLER_IDLE);
+    interval = maxInterval;
+    due = true;
+  }
+  if (!due) {
+    // the application has finished with the tag of the last poll
+    if (fieldOffPending) {
+      fieldOffPending = false;
+      reader.setRF_off();
+    }
+    return PN5180_TECH_NONE;
+  }
+  fieldOffPending = false;
+
+  // a field kept on since the last poll counts for the whole period
+  unsigned long periodMs = now - lastPoll;
+  if (periodMs > 3600000UL) periodMs = 3600000UL;
+  uint32_t periodUs = 1000UL * periodMs;
+  bool fieldWasOn = reader.isRF_on();
+  unsigned long startUs = reader.getHAL()->getMicros();
+  PN5180Technology technology = reader.discover(uid, uidLength, technologies);
+  uint32_t discoverUs = reader.getHAL()->getMicros() - startUs;
+  lastPoll = now;
+  updateDutyCycle(fieldWasOn ? periodUs + discoverUs : discoverUs, periodUs + discoverUs);
+
+  if (!checkTemperature())
+    return technology;
+
+  if (PN5180_TECH_NONE != technology) {
+    // ramp up to the fastest rate
+    emptyPolls = 0;
+    interval = minInterval;
+    enterState(PN5180_POLLER_ACTIVE);
+  }
+  else {
+    if (PN5180_POLLER_ACTIVE == state) {
+      PN5180DEBUG(F("Poller: tag left\n"));
+      interval = minInterval;
+      enterState(PN5180_POLLER_IDLE);
+    }
+    if (emptyPolls < 0xff) emptyPolls++;
+    interval = (2 * interval < maxInterval) ? 2 * interval : maxInterval;
+    if (fieldOffWhenIdle && reader.isRF_on()) {
+      reader.setRF_off();
+    }
+    if ((lpcdAfter > 0) && (emptyPolls >= lpcdAfter) && reader.hasIRQPin()) {
+      if (reader.switchToLPCD(lpcdWakeupCounter)) {
+        enterState(PN5180_POLLER_LPCD);
+        return technology;
+      }
+      PN5180DEBUG(F("Poller: switchToLPCD failed\n"));
+      emptyPolls = 0;
+    }
+  }
+
+  // RF duty cycle limit, the field is switched off for the stretched interval,
+  // with a tag present by the next poll() call
+  if (dutyCycle > maxDutyCycle) {
+    // 0 is treated as 1 per mille
+    uint32_t minPeriod = discoverUs / ((maxDutyCycle > 0) ? maxDutyCycle : 1); // ms
+    if (interval < minPeriod) interval = minPeriod;
+    if (PN5180_TECH_NONE != technology) {
+      fieldOffPending = true;
+    }
+    else if (reader.isRF_on()) {
+      PN5180DEBUG(F("Poller: duty cycle limit, RF off\n"));
+      reader.setRF_off();
+    }
+  }
+  return technology;
+}
+
+/*
+ * Poll with the next call of poll(), e.g. after a button press. Ends LPCD,
+ * does not end the cooldown.
+ */
+void PN5180AdaptivePoller::wakeup() {
+  if (PN5180_POLLER_LPCD == state) {
+    leaveLPCD();
+  }
+  if (PN5180_POLLER_COOLDOWN == state) {
+    return;
+  }
+  emptyPolls = 0;
+  interval = minInterval;
+  lastPoll = reader.getHAL()->getMillis() - interval;
+}
+
+PN5180PollerState PN5180AdaptivePoller::getState() {
+  return state;
+}
+
+/*
+ * Current poll interval in ms
+ */
+uint32_t PN5180AdaptivePoller::getInterval() {
+  return interval;
+}
+
+/*
+ * Smoothed RF field-on time in per mille
+ */
+uint16_t PN5180AdaptivePoller::getDutyCycle() {
+  return dutyCycle;
+}
+
+void PN5180AdaptivePoller::enterState(PN5180PollerState newState) {
+  if (newState != state) {
+    state = newState;
+    stateStarted = reader.getHAL()->getMillis();
+  }
+}
+
+/*
+ * The reset returns the PN5180 from LPCD to a known state
+ */
+bool PN5180AdaptivePoller::leaveLPCD() {
+  PN5180DEBUG(F("Poller: leaving LPCD\n"));
+  bool success = reader.reset();
+  emptyPolls = 0;
+  interval = minInterval;
+  enterState(PN5180_POLLER_IDLE);
+  return success;
+}
+
+/*
+ * False and the cooldown started, if the PN5180 reports overtemperature
+ */
+bool PN5180AdaptivePoller::checkTemperature() {
+  if (0 == (reader.getIRQStatus() & TEMPSENS_ERROR_IRQ_STAT))
+    return true;
+  PN5180DEBUG(F("Poller: overtemperature, RF off\n"));
+  reader.setRF_off();
+  enterState(PN5180_POLLER_COOLDOWN);
+  return false;
+}
+
+/*
+ * Exponential average with weight 1/4 of the last period
+ */
+void PN5180AdaptivePoller::updateDutyCycle(uint32_t fieldOnUs, uint32_t periodUs) {
+  if (0 == periodUs)
+    return;
+  // per mille without overflow for periods up to an hour
+  uint32_t duty = (fieldOnUs >= periodUs) ? 1000 : (uint32_t)((uint64_t)fieldOnUs * 1000 / periodUs);
+  dutyCycle = (3 * (uint32_t)dutyCycle + duty) / 4;
+}
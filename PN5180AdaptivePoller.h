@@ -0,0 +1,86 @@
+// NAME: PN5180AdaptivePoller.h
+//
+// DESC: Polling scheduler for PN5180Discovery: backs off the poll interval
+//       while no tag is present, switches the RF field off between polls
+//       and uses LPCD when idle for long, limits the RF duty cycle.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180ADAPTIVEPOLLER_H
+#define PN5180ADAPTIVEPOLLER_H
+
+#include "PN5180Discovery.h"
+
+enum PN5180PollerState {
+  PN5180_POLLER_ACTIVE = 0,   // tag present, polled every minInterval ms
+  PN5180_POLLER_IDLE = 1,     // no tag, interval doubled with each empty poll
+  PN5180_POLLER_LPCD = 2,     // PN5180 in LPCD, waiting for the IRQ line
+  PN5180_POLLER_COOLDOWN = 3  // overtemperature, RF field off for cooldownTime ms
+};
+
+/*
+ * Call poll() from loop(), it returns immediately while no poll is due.
+ * With a tag present the field stays on and the tag is polled every
+ * minInterval ms. After an empty poll the field is switched off and
+ * the interval doubles up to maxInterval. After lpcdAfter empty polls
+ * the PN5180 enters LPCD (IRQ pin required, prepareLPCD()/calibrateLPCD()
+ * have to be done before). A detection resets the PN5180, so RF and IRQ
+ * configuration done by the application is lost after LPCD.
+ *
+ * The PN5180 has no readable temperature, only the overtemperature flag
+ * TEMPSENS_ERROR_IRQ_STAT. The interval is stretched so the field is on
+ * for at most maxDutyCycle per mille of the time, the flag starts a
+ * cooldown phase without field.
+ *
+ * Usage:
+ *   PN5180AdaptivePoller poller(nfc);
+ *   poller.begin();
+ *   loop: if (PN5180_TECH_NONE != poller.poll(uid, &uidLength)) ...
+ */
+class PN5180AdaptivePoller {
+public:
+  PN5180AdaptivePoller(PN5180Discovery &reader);
+
+  void begin();
+  PN5180Technology poll(uint8_t *uid, uint8_t *uidLength, uint8_t technologies = PN5180_TECH_ALL);
+  void wakeup();
+
+  PN5180PollerState getState();
+  uint32_t getInterval();
+  uint16_t getDutyCycle();
+
+  uint16_t minInterval = 50;       // ms
+  uint16_t maxInterval = 1000;     // ms
+  uint8_t lpcdAfter = 20;          // empty polls before LPCD, 0 = no LPCD
+  uint16_t lpcdWakeupCounter = 500; // ms, see switchToLPCD()
+  bool fieldOffWhenIdle = true;
+  uint16_t maxDutyCycle = 500;     // per mille of field-on time, 1..1000
+  uint32_t cooldownTime = 10000;   // ms
+
+private:
+  PN5180Discovery &reader;
+  PN5180PollerState state;
+  uint32_t interval;
+  unsigned long lastPoll;          // ms
+  unsigned long stateStarted;      // ms, begin of LPCD or cooldown
+  uint8_t emptyPolls;
+  uint16_t dutyCycle;              // smoothed, per mille
+  bool fieldOffPending;            // switch off when the next poll is not due
+
+  void enterState(PN5180PollerState newState);
+  bool leaveLPCD();
+  bool checkTemperature();
+  void updateDutyCycle(uint32_t fieldOnUs, uint32_t periodUs);
+};
+
+#endif /* PN5180ADAPTIVEPOLLER_H */
@@ -0,0 +1,130 @@
+// NAME: PN5180Discovery.cpp
+//
+// DESC: Polling loop for ISO14443A and ISO15693 tags on one PN5180 module.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180Discovery.h"
+#include "Debug.h"
+
+/*
+ * The virtual base PN5180 is constructed here, the PN5180 initializers of
+ * the protocol classes are not used
+ */
+PN5180Discovery::PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi)
+              : PN5180(SSpin, BUSYpin, RSTpin, spi),
+                PN5180ISO14443(SSpin, BUSYpin, RSTpin, spi),
+                PN5180ISO15693(SSpin, BUSYpin, RSTpin, spi) {
+  lastTechnology = PN5180_TECH_NONE;
+}
+
+PN5180Discovery::PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi)
+              : PN5180(SSpin, BUSYpin, RSTpin, IRQpin, spi),
+                PN5180ISO14443(SSpin, BUSYpin, RSTpin, IRQpin, spi),
+                PN5180ISO15693(SSpin, BUSYpin, RSTpin, IRQpin, spi) {
+  lastTechnology = PN5180_TECH_NONE;
+}
+
+PN5180Discovery::PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal)
+              : PN5180(SSpin, BUSYpin, RSTpin, IRQpin, hal),
+                PN5180ISO14443(SSpin, BUSYpin, RSTpin, IRQpin, hal),
+                PN5180ISO15693(SSpin, BUSYpin, RSTpin, IRQpin, hal) {
+  lastTechnology = PN5180_TECH_NONE;
+}
+
+/*
+ * Switch on the field with ISO14443A configuration
+ */
+bool PN5180Discovery::setupRF() {
+  return selectTechnology(PN5180_TECH_ISO14443A);
+}
+
+/*
+ * Load the RF configuration of the technology and switch on the field, if
+ * it is off. The guard time lets the tags power up (after field on) or
+ * settle after the modulation of the previous technology.
+ */
+bool PN5180Discovery::selectTechnology(PN5180Technology technology) {
+  bool success = (PN5180_TECH_ISO14443A == technology) ? loadRFConfig(0x00, 0x80)  // ISO14443 parameters
+                                                       : loadRFConfig(0x0D, 0x8D); // ISO15693 parameters
+  if (!success) {
+    return false;
+  }
+  if (!isRF_on()) {
+    PN5180DEBUG(F("Turning ON RF field...\n"));
+    if (!setRF_on()) {
+      return false;
+    }
+    getHAL()->delayUs(guardTime);
+  }
+  else if (technology != lastTechnology) {
+    getHAL()->delayUs(switchGuardTime);
+  }
+  lastTechnology = technology;
+  return true;
+}
+
+/*
+ * Poll the technologies within one field-on period, ISO14443A first.
+ * uid : 10 byte buffer, ISO14443A: 4/7/10 byte UID, ISO15693: 8 byte UID (LSB first)
+ * technologies : PN5180_TECH_xxx flags to poll for
+ * An ISO14443A card is activated with WUPA and stays selected.
+ * return value: technology of the first tag found, PN5180_TECH_NONE if no tag answered
+ */
+PN5180Technology PN5180Discovery::discover(uint8_t *uid, uint8_t *uidLength, uint8_t technologies) {
+  *uidLength = 0;
+
+  if (technologies & PN5180_TECH_ISO14443A) {
+    if (!selectTechnology(PN5180_TECH_ISO14443A)) {
+      return PN5180_TECH_NONE;
+    }
+    uint8_t response[13];
+    for (int i=0; i<13; i++) response[i] = 0;
+    uint8_t len = activateTypeA(response, 1);
+    if (len > 0) {
+      for (int i=0; i<10; i++) uid[i] = response[i+3];
+      *uidLength = len;
+      PN5180DEBUG(F("ISO14443A tag found\n"));
+      return PN5180_TECH_ISO14443A;
+    }
+  }
+
+  if (technologies & PN5180_TECH_ISO15693) {
+    if (!selectTechnology(PN5180_TECH_ISO15693)) {
+      return PN5180_TECH_NONE;
+    }
+    if (ISO15693_EC_OK == getInventory(uid)) {
+      *uidLength = 8;
+      PN5180DEBUG(F("ISO15693 tag found\n"));
+      return PN5180_TECH_ISO15693;
+    }
+  }
+
+  return PN5180_TECH_NONE;
+}
+
+/*
+ * Technology configured last, the following commands use its RF configuration
+ */
+PN5180Technology PN5180Discovery::getLastTechnology() {
+  return lastTechnology;
+}
+
+bool PN5180Discovery::isCardPresent() {
+  uint8_t uid[10];
+  uint8_t uidLength;
+  return (PN5180_TECH_NONE != discover(uid, &uidLength));
+}
@@ -0,0 +1,65 @@
+// NAME: PN5180Discovery.h
+//
+// DESC: Polling loop for ISO14443A and ISO15693 tags on one PN5180 module.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180DISCOVERY_H
+#define PN5180DISCOVERY_H
+
+#include "PN5180ISO14443.h"
+#include "PN5180ISO15693.h"
+
+enum PN5180Technology {
+  PN5180_TECH_NONE = 0,
+  PN5180_TECH_ISO14443A = (1<<0),
+  PN5180_TECH_ISO15693 = (1<<1),
+  PN5180_TECH_ALL = PN5180_TECH_ISO14443A | PN5180_TECH_ISO15693
+};
+
+/*
+ * Discovery modeled on the NFC Forum polling loop: the RF field stays on,
+ * only the TX/RX configuration is switched between the technologies
+ * (0x00/0x80 for ISO14443A, 0x0D/0x8D for ISO15693). The first technology
+ * with an answering tag is reported.
+ * Both protocol classes share the single PN5180 base, the protocol specific
+ * methods are called qualified, e.g. nfc.PN5180ISO14443::mifareBlockRead(..).
+ */
+class PN5180Discovery : public PN5180ISO14443, public PN5180ISO15693 {
+
+public:
+  PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi = SPI);
+  PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi = SPI);
+  PN5180Discovery(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal);
+
+private:
+  PN5180Technology lastTechnology;
+  bool selectTechnology(PN5180Technology technology);
+
+public:
+  // guard times in us with unmodulated field before polling
+  uint16_t guardTime = 5100;       // after the field was switched on
+  uint16_t switchGuardTime = 1000; // after switching the technology
+
+  PN5180Technology discover(uint8_t *uid, uint8_t *uidLength, uint8_t technologies = PN5180_TECH_ALL);
+  PN5180Technology getLastTechnology();
+
+  /*
+   * Helper functions
+   */
+public:
+  bool setupRF();
+  bool isCardPresent();
+};
+
+#endif /* PN5180DISCOVERY_H */
@@ -0,0 +1,199 @@
+// NAME: PN5180FreeRTOS.cpp
+//
+// DESC: FreeRTOS integration for ESP32: bus mutex shared with other SPI
+//       devices and a reader task reporting tags through a queue.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <Arduino.h>
+#include "PN5180FreeRTOS.h"
+#include "Debug.h"
+
+static TickType_t toTicks(uint32_t timeoutMs) {
+  return (0xffffffff == timeoutMs) ? portMAX_DELAY : pdMS_TO_TICKS(timeoutMs);
+}
+
+PN5180FreeRTOSHAL::PN5180FreeRTOSHAL(SPIClass& spi, SemaphoreHandle_t busMutex)
+                 : PN5180ArduinoHAL(spi) {
+  this->busMutex = busMutex ? busMutex : xSemaphoreCreateRecursiveMutex();
+}
+
+/*
+ * The mutex is recursive, so the transactions of the commands within
+ * lockBus()/unlockBus() only increment its count
+ */
+void PN5180FreeRTOSHAL::beginTransaction() {
+  xSemaphoreTakeRecursive(busMutex, portMAX_DELAY);
+  PN5180ArduinoHAL::beginTransaction();
+}
+
+void PN5180FreeRTOSHAL::endTransaction() {
+  PN5180ArduinoHAL::endTransaction();
+  xSemaphoreGiveRecursive(busMutex);
+}
+
+bool PN5180FreeRTOSHAL::lockBus(uint32_t timeoutMs) {
+  return (pdTRUE == xSemaphoreTakeRecursive(busMutex, toTicks(timeoutMs)));
+}
+
+void PN5180FreeRTOSHAL::unlockBus() {
+  xSemaphoreGiveRecursive(busMutex);
+}
+
+SemaphoreHandle_t PN5180FreeRTOSHAL::getBusMutex() {
+  return busMutex;
+}
+
+PN5180ReaderTask::PN5180ReaderTask(PN5180Discovery &reader) : reader(reader) {
+  queue = 0;
+  task = 0;
+  exited = 0;
+  stopRequested = false;
+  clearCurrent();
+}
+
+PN5180ReaderTask::~PN5180ReaderTask() {
+  stop();
+  if (queue) vQueueDelete(queue);
+  if (exited) vSemaphoreDelete(exited);
+}
+
+void PN5180ReaderTask::clearCurrent() {
+  current.type = 0;
+  current.technology = PN5180_TECH_NONE;
+  current.uidLength = 0;
+  for (uint8_t i = 0; i < sizeof(current.uid); i++) current.uid[i] = 0;
+  missedCycles = 0;
+}
+
+/*
+ * Creates the event queue and the task, the reader must be initialized
+ * (begin(), reset()) before
+ */
+bool PN5180ReaderTask::start(uint8_t queueLength, UBaseType_t priority, uint32_t stackSize, BaseType_t core) {
+  if (task)
+    return false;
+  if (!queue) {
+    queue = xQueueCreate(queueLength, sizeof(PN5180Event));
+    if (!queue)
+      return false;
+  }
+  if (!exited) {
+    exited = xSemaphoreCreateBinary();
+    if (!exited)
+      return false;
+  }
+  stopRequested = false;
+  clearCurrent();
+  if (pdPASS != xTaskCreatePinnedToCore(taskMain, "PN5180", stackSize, this, priority, &task, core)) {
+    task = 0;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Waits until the task has ended after its current polling cycle, the
+ * queue is kept. Called from the task itself, it only requests the end.
+ */
+void PN5180ReaderTask::stop() {
+  stopRequested = true;
+  if (!task || (xTaskGetCurrentTaskHandle() == task))
+    return;
+  xSemaphoreTake(exited, portMAX_DELAY);
+  task = 0;
+}
+
+bool PN5180ReaderTask::isRunning() {
+  return (0 != task);
+}
+
+bool PN5180ReaderTask::waitForEvent(PN5180Event *event, uint32_t timeoutMs) {
+  if (!queue)
+    return false;
+  return (pdTRUE == xQueueReceive(queue, event, toTicks(timeoutMs)));
+}
+
+QueueHandle_t PN5180ReaderTask::getQueue() {
+  return queue;
+}
+
+void PN5180ReaderTask::taskMain(void *arg) {
+  PN5180ReaderTask *self = (PN5180ReaderTask *)arg;
+  while (!self->stopRequested) {
+    self->poll();
+    vTaskDelay(pdMS_TO_TICKS(self->pollInterval));
+  }
+  // stop() clears task after this, the object may be gone right after
+  xSemaphoreGive(self->exited);
+  vTaskDelete(0);
+}
+
+/*
+ * One discovery cycle with the bus locked
+ */
+void PN5180ReaderTask::poll() {
+  uint8_t uid[10];
+  uint8_t uidLength = 0;
+
+  // skip the cycle if another device holds the bus that long
+  if (!reader.lockBus(pollInterval))
+    return;
+  PN5180Technology technology = reader.discover(uid, &uidLength, technologies);
+  if (PN5180_TECH_NONE == technology)
+    uidLength = 0;
+  if (PN5180_TECH_ISO14443A == technology) {
+    // HALT, so the card answers the WUPA of the next cycle
+    reader.mifareHalt();
+  }
+  reader.unlockBus();
+
+  bool same = (technology == current.technology) && (uidLength == current.uidLength);
+  for (uint8_t i = 0; same && (i < uidLength); i++) {
+    same = (uid[i] == current.uid[i]);
+  }
+
+  if ((current.uidLength > 0) && !same) {
+    // another tag or none answered
+    if ((PN5180_TECH_NONE != technology) || (++missedCycles >= leaveCycles)) {
+      post(PN5180_EVENT_TAG_LEFT);
+      current.uidLength = 0;
+    }
+  }
+  if ((PN5180_TECH_NONE != technology) && (same || (0 == current.uidLength))) {
+    missedCycles = 0;
+    if (0 == current.uidLength) {
+      current.technology = technology;
+      current.uidLength = uidLength;
+      for (uint8_t i = 0; i < uidLength; i++) current.uid[i] = uid[i];
+      post(PN5180_EVENT_TAG_ARRIVED);
+    }
+  }
+}
+
+/*
+ * A full queue drops the event, the task never blocks on the application
+ */
+void PN5180ReaderTask::post(uint8_t type) {
+  PN5180Event event = current;
+  event.type = type;
+  if (pdTRUE != xQueueSend(queue, &event, 0)) {
+    PN5180DEBUG(F("PN5180ReaderTask: event queue full\n"));
+  }
+}
+
+#endif /* ARDUINO_ARCH_ESP32 */
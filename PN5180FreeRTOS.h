@@ -0,0 +1,108 @@
+// NAME: PN5180FreeRTOS.h
+//
+// DESC: FreeRTOS integration for ESP32: bus mutex shared with other SPI
+//       devices and a reader task reporting tags through a queue.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180FREERTOS_H
+#define PN5180FREERTOS_H
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include "PN5180HAL.h"
+#include "PN5180Discovery.h"
+
+/*
+ * Arduino HAL with a recursive mutex around each SPI transaction. Pass the
+ * same mutex to the drivers of the other devices on the bus (display, SD
+ * card) and take it there too. PN5180::lockBus() holds it over several
+ * commands. If no mutex is given, the HAL creates its own.
+ * Build the library with -DPN5180_FREERTOS, so waits for BUSY and IRQ
+ * block the task instead of spinning.
+ */
+class PN5180FreeRTOSHAL : public PN5180ArduinoHAL {
+public:
+  PN5180FreeRTOSHAL(SPIClass& spi = SPI, SemaphoreHandle_t busMutex = 0);
+
+  virtual void beginTransaction();
+  virtual void endTransaction();
+  virtual bool lockBus(uint32_t timeoutMs);
+  virtual void unlockBus();
+
+  SemaphoreHandle_t getBusMutex();
+
+private:
+  SemaphoreHandle_t busMutex;
+};
+
+#define PN5180_EVENT_TAG_ARRIVED (1)
+#define PN5180_EVENT_TAG_LEFT    (2)
+
+struct PN5180Event {
+  uint8_t type;                // PN5180_EVENT_xxx
+  PN5180Technology technology;
+  uint8_t uidLength;
+  uint8_t uid[10];             // ISO15693: LSB first
+};
+
+/*
+ * Task polling with PN5180Discovery. The bus is locked for each polling
+ * cycle only, between the cycles the task sleeps pollInterval ms.
+ * ISO14443A cards are halted after each cycle and woken by the next WUPA,
+ * a tag not answering in leaveCycles polls is reported as left.
+ *
+ * Usage:
+ *   PN5180ReaderTask readerTask(nfc);
+ *   readerTask.start();
+ *   PN5180Event event;
+ *   if (readerTask.waitForEvent(&event, 1000)) ...
+ */
+class PN5180ReaderTask {
+public:
+  PN5180ReaderTask(PN5180Discovery &reader);
+  ~PN5180ReaderTask();
+
+  bool start(uint8_t queueLength = 4, UBaseType_t priority = 1,
+             uint32_t stackSize = 4096, BaseType_t core = tskNO_AFFINITY);
+  void stop();
+  bool isRunning();
+  bool waitForEvent(PN5180Event *event, uint32_t timeoutMs);
+  QueueHandle_t getQueue();
+
+  uint32_t pollInterval = 100; // ms
+  uint8_t leaveCycles = 2;
+  uint8_t technologies = PN5180_TECH_ALL;
+
+private:
+  PN5180Discovery &reader;
+  QueueHandle_t queue;
+  TaskHandle_t task;
+  SemaphoreHandle_t exited; // given by the task when it ends
+  volatile bool stopRequested;
+  PN5180Event current;   // tag present, uidLength 0 = none
+  uint8_t missedCycles;
+
+  static void taskMain(void *arg);
+  void clearCurrent();
+  void poll();
+  void post(uint8_t type);
+};
+
+#endif /* ARDUINO_ARCH_ESP32 */
+
+#endif /* PN5180FREERTOS_H */
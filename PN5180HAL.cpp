@@ -0,0 +1,148 @@
+// NAME: PN5180HAL.cpp
+//
+// DESC: Hardware abstraction of the PN5180 host interface: SPI bus, GPIO and clock.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <Arduino.h>
+#include "PN5180HAL.h"
+
+// ESP32/ESP8266 cores provide writeBytes/transferBytes, which fill the
+// SPI hardware FIFO with a whole block instead of one byte per call
+#if defined(ARDUINO_ARCH_ESP32) || defined(ARDUINO_ARCH_ESP8266)
+#define PN5180_SPI_TRANSFER_BYTES
+#endif
+
+/*
+ * Milliseconds in steps of delayUs(), which takes 16 bit values on AVR
+ */
+void PN5180HAL::delayMs(unsigned long ms) {
+  while (ms-- > 0) {
+    delayUs(1000);
+  }
+}
+
+/*
+ * Without interrupts PN5180 polls the IRQ_STATUS register
+ */
+bool PN5180HAL::attachIRQ(uint8_t, void (*)()) {
+  return false;
+}
+
+void PN5180HAL::detachIRQ(uint8_t) {
+}
+
+/*
+ * Without an RTOS the bus is used by one thread only
+ */
+bool PN5180HAL::lockBus(uint32_t) {
+  return true;
+}
+
+void PN5180HAL::unlockBus() {
+}
+
+/*
+ * The SPIClass is kept as reference, so several instances can share one bus
+ * or use different buses (e.g. HSPI/VSPI on ESP32).
+ */
+PN5180ArduinoHAL::PN5180ArduinoHAL(SPIClass& spi) : spi(spi) {
+}
+
+void PN5180ArduinoHAL::spiBegin() {
+  spi.begin();
+}
+
+void PN5180ArduinoHAL::spiEnd() {
+  spi.end();
+}
+
+/*
+ * The settings are created once here, not for every transaction
+ */
+void PN5180ArduinoHAL::setSPIClock(uint32_t clock) {
+  settings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+}
+
+void PN5180ArduinoHAL::beginTransaction() {
+  spi.beginTransaction(settings);
+}
+
+void PN5180ArduinoHAL::endTransaction() {
+  spi.endTransaction();
+}
+
+/*
+ * The send data must not be modified, so on platforms without a write-only
+ * block transfer the bytes are sent one by one. Received frames are read
+ * in place with the block transfer.
+ */
+void PN5180ArduinoHAL::spiWrite(const uint8_t *data, size_t len) {
+#ifdef PN5180_SPI_TRANSFER_BYTES
+  spi.writeBytes(data, len);
+#else
+  for (size_t i=0; i<len; i++) {
+    spi.transfer(data[i]);
+  }
+#endif
+}
+
+void PN5180ArduinoHAL::spiRead(uint8_t *buffer, size_t len) {
+#ifdef PN5180_SPI_TRANSFER_BYTES
+  spi.transferBytes(buffer, buffer, len);
+#else
+  spi.transfer(buffer, len);
+#endif
+}
+
+void PN5180ArduinoHAL::setPinMode(uint8_t pin, uint8_t mode) {
+  pinMode(pin, mode);
+}
+
+void PN5180ArduinoHAL::writePin(uint8_t pin, uint8_t value) {
+  digitalWrite(pin, value);
+}
+
+int PN5180ArduinoHAL::readPin(uint8_t pin) {
+  return digitalRead(pin);
+}
+
+unsigned long PN5180ArduinoHAL::getMillis() {
+  return millis();
+}
+
+unsigned long PN5180ArduinoHAL::getMicros() {
+  return micros();
+}
+
+void PN5180ArduinoHAL::delayUs(unsigned int us) {
+  delayMicroseconds(us);
+}
+
+void PN5180ArduinoHAL::delayMs(unsigned long ms) {
+  delay(ms);
+}
+
+bool PN5180ArduinoHAL::attachIRQ(uint8_t pin, void (*handler)()) {
+  int irq = digitalPinToInterrupt(pin);
+#ifdef NOT_AN_INTERRUPT
+  if (NOT_AN_INTERRUPT == irq)
+    return false;
+#endif
+  attachInterrupt(irq, handler, RISING);
+  return true;
+}
+
+void PN5180ArduinoHAL::detachIRQ(uint8_t pin) {
+  detachInterrupt(digitalPinToInterrupt(pin));
+}
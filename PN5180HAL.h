@@ -0,0 +1,93 @@
+// NAME: PN5180HAL.h
+//
+// DESC: Hardware abstraction of the PN5180 host interface: SPI bus, GPIO and clock.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180HAL_H
+#define PN5180HAL_H
+
+#include <Arduino.h>
+#include <SPI.h>
+
+/*
+ * Everything PN5180 needs from the platform for the host interface. A HAL
+ * given to the PN5180 constructor replaces the Arduino functions, e.g. to
+ * drive the module through an I/O expander or to run the library against
+ * a simulated PN5180 (see extras/host).
+ */
+class PN5180HAL {
+public:
+  // SPI bus, MSB first, SPI_MODE0
+  virtual void spiBegin() = 0;
+  virtual void spiEnd() = 0;
+  virtual void setSPIClock(uint32_t clock) = 0;
+  virtual void beginTransaction() = 0;
+  virtual void endTransaction() = 0;
+  virtual void spiWrite(const uint8_t *data, size_t len) = 0;
+  // buffer is prefilled with 0xff, the bytes sent while reading
+  virtual void spiRead(uint8_t *buffer, size_t len) = 0;
+
+  // GPIO
+  virtual void setPinMode(uint8_t pin, uint8_t mode) = 0;
+  virtual void writePin(uint8_t pin, uint8_t value) = 0;
+  virtual int readPin(uint8_t pin) = 0;
+
+  // clock
+  virtual unsigned long getMillis() = 0;
+  virtual unsigned long getMicros() = 0;
+  virtual void delayUs(unsigned int us) = 0;
+  virtual void delayMs(unsigned long ms);
+
+  // handler called on the rising edge of the IRQ pin, false if not supported
+  virtual bool attachIRQ(uint8_t pin, void (*handler)());
+  virtual void detachIRQ(uint8_t pin);
+
+  // exclusive use of the bus for several commands, see PN5180::lockBus()
+  virtual bool lockBus(uint32_t timeoutMs);
+  virtual void unlockBus();
+};
+
+/*
+ * Default HAL with the Arduino SPI library and GPIO functions
+ */
+class PN5180ArduinoHAL : public PN5180HAL {
+public:
+  PN5180ArduinoHAL(SPIClass& spi = SPI);
+
+  virtual void spiBegin();
+  virtual void spiEnd();
+  virtual void setSPIClock(uint32_t clock);
+  virtual void beginTransaction();
+  virtual void endTransaction();
+  virtual void spiWrite(const uint8_t *data, size_t len);
+  virtual void spiRead(uint8_t *buffer, size_t len);
+
+  virtual void setPinMode(uint8_t pin, uint8_t mode);
+  virtual void writePin(uint8_t pin, uint8_t value);
+  virtual int readPin(uint8_t pin);
+
+  virtual unsigned long getMillis();
+  virtual unsigned long getMicros();
+  virtual void delayUs(unsigned int us);
+  virtual void delayMs(unsigned long ms);
+
+  virtual bool attachIRQ(uint8_t pin, void (*handler)());
+  virtual void detachIRQ(uint8_t pin);
+
+private:
+  SPIClass& spi;
+  SPISettings settings;
+};
+
+#endif /* PN5180HAL_H */
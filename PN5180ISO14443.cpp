@@ -23,8 +23,37 @@
 #include <PN5180.h>
 #include "Debug.h"
 
-PN5180ISO14443::PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin) 
-              : PN5180(SSpin, BUSYpin, RSTpin) {
+PN5180ISO14443::PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi) 
+              : PN5180(SSpin, BUSYpin, RSTpin, spi) {
+	trackedUidLength = 0;
+	removedCallback = 0;
+	isoDepBlockNumber = 0;
+	isoDepFsc = 32;
+	isoDepFwt = 302UL << 4;
+	isoDepBitRate = PN5180_ISODEP_106;
+	isoDepActive = false;
+}
+
+PN5180ISO14443::PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi) 
+              : PN5180(SSpin, BUSYpin, RSTpin, IRQpin, spi) {
+	trackedUidLength = 0;
+	removedCallback = 0;
+	isoDepBlockNumber = 0;
+	isoDepFsc = 32;
+	isoDepFwt = 302UL << 4;
+	isoDepBitRate = PN5180_ISODEP_106;
+	isoDepActive = false;
+}
+
+PN5180ISO14443::PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal) 
+              : PN5180(SSpin, BUSYpin, RSTpin, IRQpin, hal) {
+	trackedUidLength = 0;
+	removedCallback = 0;
+	isoDepBlockNumber = 0;
+	isoDepFsc = 32;
+	isoDepFwt = 302UL << 4;
+	isoDepBitRate = PN5180_ISODEP_106;
+	isoDepActive = false;
 }
 
 bool PN5180ISO14443::setupRF() {
@@ -51,166 +80,624 @@ uint16_t PN5180ISO14443::rxBytesReceived() {
 	len = (uint16_t)(rxStatus & 0x000001ff);
 	return len;
 }
+
 /*
-* buffer : must be 10 byte array
+ * Send a frame to the card and wait until its response has been received
+ * completely. Returns false, if the card did not answer in time.
+ * continueCycle: the frame follows a received frame of the same exchange,
+ * the transceive cycle is still active and is not restarted (sendDataFast)
+ * timeoutUs: max. time until the response is complete, long responses need
+ * about 86us per byte at 106kbit/s
+ */
+bool PN5180ISO14443::transceiveFrame(uint8_t *data, int len, uint8_t validBits, bool continueCycle, uint32_t timeoutUs) {
+	// clearing RX_IRQ is batched with the register writes of sendData
+	beginRegisterBatch();
+	clearIRQStatus(RX_IRQ_STAT);
+	bool success = continueCycle ? sendDataFast(data, len, validBits) : sendData(data, len, validBits);
+	if (!endRegisterBatch() || !success)
+	  return false;
+	uint32_t irqStatus = waitForIRQ(RX_IRQ_STAT, timeoutUs);
+	return (0 != (irqStatus & RX_IRQ_STAT));
+}
+/*
+* buffer : must be 13 byte array
 * buffer[0-1] is ATQA
 * buffer[2] is sak
 * buffer[3..6] is 4 byte UID
 * buffer[7..9] is remaining 3 bytes of UID for 7 Byte UID tags
+* buffer[10..12] is remaining 3 bytes of UID for 10 Byte UID tags
 * kind : 0  we send REQA, 1 we send WUPA
 *
+* If several cards answer, the anticollision selects one of them (the one
+* with bit value 1 at each collision position).
+*
 * return value: the uid length:
 * -	zero if no tag was recognized
 * -	single Size UID (4 byte)
 * -	double Size UID (7 byte)
-* -	triple Size UID (10 byte) - not yet supported
+* -	triple Size UID (10 byte)
 */
 uint8_t PN5180ISO14443::activateTypeA(uint8_t *buffer, uint8_t kind) {
+	PN5180STATS(PN5180StatsTimer timer(getHAL(), &stats.activateTypeA));
 	uint8_t cmd[7];
 	uint8_t uidLength = 0;
+	// a new activation ends ISO-DEP, the RF config is back at 106 kbit/s
+	isoDepActive = false;
+	isoDepBitRate = PN5180_ISODEP_106;
 	// Load standard TypeA protocol
 	if (!loadRFConfig(0x0, 0x80)) 
 	  return 0;
 
+	// Batch the register setup into one WRITE_REGISTER_MULTIPLE command,
+	// it is sent together with the register writes of the REQA/WUPA frame
+	beginRegisterBatch();
 	// OFF Crypto
-	if (!writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF))
-	  return 0;
+	writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF);
 	// Clear RX CRC
-	if (!writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE))
-	  return 0;
+	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
 	// Clear TX CRC
-	if (!writeRegisterWithAndMask(CRC_TX_CONFIG, 0xFFFFFFFE))
-	  return 0;
+	writeRegisterWithAndMask(CRC_TX_CONFIG, 0xFFFFFFFE);
 	// Clear the interrupt register IRQ_STATUS
 	clearIRQStatus(TX_IRQ_STAT);
-	// Sets the PN5180 into IDLE state  
-	if (!writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFF8))
-	  return 0;
-	
-	// Activates TRANSCEIVE routine  
-	if (!writeRegisterWithOrMask(SYSTEM_CONFIG, 0x00000003))
-	  return 0;
 	
 	//Send REQA/WUPA, 7 bits in last byte
+	//sendData sets the PN5180 into IDLE state and activates the TRANSCEIVE routine,
+	//the following frames of the activation are sent within this transceive cycle
 	cmd[0] = (kind == 0) ? 0x26 : 0x52;
-	if (!sendData(cmd, 1, 0x07))
+	bool success = transceiveFrame(cmd, 1, 0x07);
+	if (!endRegisterBatch() || !success)
 	  return 0;
 	// READ 2 bytes ATQA into  buffer
 	if (!readData(2, buffer)) 
 	  return 0;
-	//Send Anti collision 1, 8 bits in last byte
-	cmd[0] = 0x93;
-	cmd[1] = 0x20;
-	if (!sendData(cmd, 2, 0x00))
-	  return 0;
-	//Read 5 bytes, we will store at offset 2 for later usage
-	if (!readData(5, cmd+2)) 
-	  return 0;
-	//Enable RX CRC calculation
-	if (!writeRegisterWithOrMask(CRC_RX_CONFIG, 0x01)) 
-	  return 0;
-	//Enable TX CRC calculation
-	if (!writeRegisterWithOrMask(CRC_TX_CONFIG, 0x01)) 
-	  return 0;
-	//Send Select anti collision 1, the remaining bytes are already in offset 2 onwards
-	cmd[0] = 0x93;
-	cmd[1] = 0x70;
-	if (!sendData(cmd, 7, 0x00)) 
-	  return 0;
-	//Read 1 byte SAK into buffer[2]
-	if (!readData(1, buffer+2)) 
-	  return 0;
-	// Check if the tag is 4 Byte UID or 7 byte UID and requires anti collision 2
-	// If Bit 3 is 0 it is 4 Byte UID
-	if ((buffer[2] & 0x04) == 0) {
-		// Take first 4 bytes of anti collision as UID store at offset 3 onwards. job done
-		for (int i = 0; i < 4; i++) buffer[3+i] = cmd[2 + i];
-		uidLength = 4;
-	}
-	else {
-		// Take First 3 bytes of UID, Ignore first byte 88(CT)
+
+	// Cascade levels 1-3, select code 0x93, 0x95, 0x97
+	for (uint8_t level = 0; level < 3; level++) {
+		uint8_t sel = 0x93 + 2*level;
+		beginRegisterBatch();
+		if (level > 0) {
+			// Clear RX CRC
+			writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
+			// Clear TX CRC
+			writeRegisterWithAndMask(CRC_TX_CONFIG, 0xFFFFFFFE);
+		}
+		//Anti collision, 4 bytes UID (or CT + 3 bytes) and BCC are stored at offset 2
+		success = anticollision(sel, cmd+2);
+		if (success) {
+			//Enable RX CRC calculation
+			writeRegisterWithOrMask(CRC_RX_CONFIG, 0x01);
+			//Enable TX CRC calculation
+			writeRegisterWithOrMask(CRC_TX_CONFIG, 0x01);
+			//Send Select, the UID bytes are already in offset 2 onwards
+			cmd[0] = sel;
+			cmd[1] = 0x70;
+			success = transceiveFrame(cmd, 7, 0x00, true);
+		}
+		if (!endRegisterBatch() || !success)
+		  return 0;
+		//Read 1 byte SAK into buffer[2]
+		if (!readData(1, buffer+2)) 
+		  return 0;
+		// If Bit 3 of SAK is 0, the UID is complete
+		if ((buffer[2] & 0x04) == 0) {
+			// Take all 4 bytes of this cascade level
+			for (int i = 0; i < 4; i++) buffer[3 + uidLength + i] = cmd[2 + i];
+			uidLength += 4;
+			PN5180STATS(timer.success = true);
+			return uidLength;
+		}
+		// Take 3 bytes of UID, Ignore first byte 88(CT)
 		if (cmd[2] != 0x88)
 		  return 0;
-		for (int i = 0; i < 3; i++) buffer[3+i] = cmd[3 + i];
-		// Clear RX CRC
-		if (!writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE)) 
-	      return 0;
-		// Clear TX CRC
-		if (!writeRegisterWithAndMask(CRC_TX_CONFIG, 0xFFFFFFFE)) 
-	      return 0;
-		// Do anti collision 2
-		cmd[0] = 0x95;
-		cmd[1] = 0x20;
-		if (!sendData(cmd, 2, 0x00)) 
-	      return 0;
-		//Read 5 bytes. we will store at offset 2 for later use
-		if (!readData(5, cmd+2)) 
-	      return 0;
-		// first 4 bytes belongs to last 4 UID bytes, we keep it.
-		for (int i = 0; i < 4; i++) {
-		  buffer[6 + i] = cmd[2+i];
+		for (int i = 0; i < 3; i++) buffer[3 + uidLength + i] = cmd[3 + i];
+		uidLength += 3;
+	}
+	// more than 3 cascade levels are not defined
+	return 0;
+}
+
+/*
+ * Bit oriented anticollision loop of one cascade level, ISO 14443-3 6.5.3.
+ * The known bits of the UID are sent with NVB, all cards matching them
+ * answer with their remaining bits. On a collision (RX_STATUS), the bits
+ * before the collision position are taken, the colliding bit is set to 1
+ * and the loop is repeated with the longer prefix.
+ * RX_COLL_POS is counted from the first received bit.
+ * uid: 5 bytes, UID (or CT + 3 bytes UID) and BCC
+ */
+bool PN5180ISO14443::anticollision(uint8_t sel, uint8_t *uid) {
+	uint8_t cmd[7];
+	uint8_t rx[5];
+	uint8_t knownBits = 0;
+
+	for (int i = 0; i < 5; i++) uid[i] = 0;
+
+	while (knownBits < 40) {
+		uint8_t knownBytes = knownBits / 8;
+		uint8_t lastBits = knownBits % 8;
+		uint8_t txBytes = knownBytes + ((lastBits > 0) ? 1 : 0);
+
+		cmd[0] = sel;
+		cmd[1] = 0x20 + (knownBytes << 4) + lastBits; // NVB
+		for (int i = 0; i < txBytes; i++) cmd[2 + i] = uid[i];
+
+		beginRegisterBatch();
+		// Align received bits to the first unknown bit (RX_BIT_ALIGN)
+		writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFE3F);
+		if (lastBits > 0) {
+			writeRegisterWithOrMask(CRC_RX_CONFIG, (uint32_t)lastBits << 6);
+		}
+		bool success = transceiveFrame(cmd, 2 + txBytes, lastBits, true);
+		if (!endRegisterBatch() || !success)
+		  return false;
+
+		uint32_t rxStatus;
+		if (!readRegister(RX_STATUS, &rxStatus))
+		  return false;
+		uint16_t len = (uint16_t)(rxStatus & RX_BYTES_RECEIVED_MASK);
+		if (len > 5) len = 5;
+		for (int i = 0; i < 5; i++) rx[i] = 0;
+		if ((len > 0) && !readData(len, rx))
+		  return false;
+
+		uint8_t validBits = 40 - knownBits;
+		bool collision = (0 != (rxStatus & RX_COLLISION_DETECTED));
+		if (collision) {
+			uint8_t collPos = (uint8_t)((rxStatus & RX_COLL_POS_MASK) >> RX_COLL_POS_SHIFT);
+			if (collPos < validBits) validBits = collPos;
+			else collision = false;
+		}
+		// Only received bits are merged, a shorter answer is an incomplete frame
+		uint8_t receivedBits = (8 * len > lastBits) ? (8 * len - lastBits) : 0;
+		if (validBits > receivedBits)
+		  return false;
+
+		// Merge the received bits, the first one is at bit position lastBits
+		for (uint8_t i = 0; i < validBits; i++) {
+			uint8_t rxBit = lastBits + i;
+			uint8_t uidBit = knownBits + i;
+			if (rx[rxBit / 8] & (1 << (rxBit % 8)))
+			  uid[uidBit / 8] |= (1 << (uidBit % 8));
+			else
+			  uid[uidBit / 8] &= ~(1 << (uidBit % 8));
+		}
+		knownBits += validBits;
+
+		if (collision) {
+			PN5180DEBUG(F("Collision at bit "));
+			PN5180DEBUG(knownBits);
+			PN5180DEBUG("\n");
+			// Continue with the cards having a 1 at the collision position
+			uid[knownBits / 8] |= (1 << (knownBits % 8));
+			knownBits++;
 		}
-		//Enable RX CRC calculation
-		if (!writeRegisterWithOrMask(CRC_RX_CONFIG, 0x01)) 
-	      return 0;
-		//Enable TX CRC calculation
-		if (!writeRegisterWithOrMask(CRC_TX_CONFIG, 0x01)) 
-	      return 0;
-		//Send Select anti collision 2 
-		cmd[0] = 0x95;
-		cmd[1] = 0x70;
-		if (!sendData(cmd, 7, 0x00)) 
-	      return 0;
-		//Read 1 byte SAK into buffer[2]
-		if (!readData(1, buffer + 2)) 
-	      return 0;	
-		uidLength = 7;
 	}
-    return uidLength;
+
+	// Reset RX_BIT_ALIGN
+	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFE3F);
+
+	// Check BCC
+	return (uid[4] == (uid[0] ^ uid[1] ^ uid[2] ^ uid[3]));
 }
 
 bool PN5180ISO14443::mifareBlockRead(uint8_t blockno, uint8_t *buffer) {
-	bool success = false;
-	uint16_t len;
-	uint8_t cmd[1];
+	uint8_t cmd[2];
 	// Send mifare command 30,blockno
 	cmd[0] = 0x30;
 	cmd[1] = blockno;
-	if (!sendData(cmd, 2, 0x00))
+	if (!transceiveFrame(cmd, 2, 0x00))
 	  return false;
 	//Check if we have received any data from the tag
-	delay(5);
-	len = rxBytesReceived();
-	if (len == 16) {
-		// READ 16 bytes into  buffer
-		if (readData(16, buffer))
-		  success = true;
-	}
-	return success;
+	if (rxBytesReceived() != 16)
+	  return false;
+	// READ 16 bytes into  buffer
+	return readData(16, buffer);
+}
+
+/*
+ * MIFARE Classic 1K/4K sector layout: sectors 0..31 have 4 blocks,
+ * sectors 32..39 (4K only) have 16 blocks. The last block is the sector trailer.
+ */
+uint8_t PN5180ISO14443::sectorFirstBlock(uint8_t sector) {
+	if (sector < 32)
+	  return sector * 4;
+	return 128 + (sector - 32) * 16;
 }
 
+uint8_t PN5180ISO14443::sectorBlockCount(uint8_t sector) {
+	return (sector < 32) ? 4 : 16;
+}
+
+/*
+ * Read all blocks of a MIFARE Classic sector with one authentication.
+ * The card must have been activated (e.g. readCardSerial without halt, or
+ * activateTypeA), uid/uidLength as returned by activateTypeA.
+ * buffer : 16 bytes per block, 64 bytes for sectors 0..31, 256 bytes for sectors 32..39,
+ *          including the sector trailer (the keys read as zero)
+ */
+bool PN5180ISO14443::readSector(uint8_t sector, const uint8_t *key, uint8_t keyType, const uint8_t *uid, uint8_t uidLength, uint8_t *buffer) {
+	if ((sector > 39) || (uidLength < 4))
+	  return false;
+	uint8_t firstBlock = sectorFirstBlock(sector);
+	uint8_t numBlocks = sectorBlockCount(sector);
+
+	// the last 4 bytes of the UID are used for 7 byte UIDs
+	if (MIFARE_AUTH_OK != mifareAuthenticate(firstBlock, key, keyType, uid + ((uidLength == 7) ? 3 : 0)))
+	  return false;
+	for (uint8_t i = 0; i < numBlocks; i++) {
+		if (!mifareBlockRead(firstBlock + i, buffer + 16*i))
+		  return false;
+	}
+	return true;
+}
 
 uint8_t PN5180ISO14443::mifareBlockWrite16(uint8_t blockno, uint8_t *buffer) {
-	uint8_t cmd[1];
-	// Clear RX CRC
+	uint8_t cmd[2];
+	uint8_t ack = 0;
+	// Clear RX CRC, the ACK/NAK is a 4 bit answer without CRC
 	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
 
 	// Mifare write part 1
 	cmd[0] = 0xA0;
 	cmd[1] = blockno;
-	sendData(cmd, 2, 0x00);
-	readData(1, cmd);
+	if (transceiveFrame(cmd, 2, 0x00) && readData(1, &ack) && (0x0A == (ack & 0x0F))) {
+		// Mifare write part 2, the ACK is sent after programming
+		ack = 0;
+		if (transceiveFrame(buffer, 16, 0x00, true, PN5180ISO14443_WRITE_TIMEOUT)) {
+			// Read ACK/NAK
+			readData(1, &ack);
+		}
+	}
 
-	// Mifare write part 2
-	sendData(buffer,16, 0x00);
-	delay(10);
+	//Enable RX CRC calculation
+	writeRegisterWithOrMask(CRC_RX_CONFIG, 0x1);
+	return ack;
+}
 
-	// Read ACK/NAK
-	readData(1, cmd);
+/*
+ * NTAG/Ultralight WRITE, code=A2
+ * Writes the 4 bytes of one page, returns the ACK/NAK (0x0A is ACK)
+ */
+uint8_t PN5180ISO14443::ntagWrite(uint8_t page, const uint8_t *data) {
+	uint8_t cmd[6];
+	uint8_t ack = 0;
+	// Clear RX CRC, the ACK/NAK is a 4 bit answer without CRC
+	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
+
+	cmd[0] = 0xA2;
+	cmd[1] = page;
+	for (uint8_t i = 0; i < 4; i++) cmd[2 + i] = data[i];
+	if (transceiveFrame(cmd, 6, 0x00, false, PN5180ISO14443_WRITE_TIMEOUT)) {
+		readData(1, &ack);
+	}
 
 	//Enable RX CRC calculation
 	writeRegisterWithOrMask(CRC_RX_CONFIG, 0x1);
-	return cmd[0];
+	return ack;
+}
+
+/*
+ * NTAG/Ultralight EV1 FAST_READ, code=3A
+ * Reads the pages startPage..endPage (4 bytes each) with as few exchanges as
+ * possible, each one up to PN5180ISO14443_FAST_READ_PAGES pages.
+ * buffer : 4 * (endPage - startPage + 1) bytes
+ */
+bool PN5180ISO14443::ntagFastRead(uint8_t startPage, uint8_t endPage, uint8_t *buffer) {
+	if (endPage < startPage)
+	  return false;
+	uint8_t cmd[3];
+	uint16_t page = startPage;
+	while (page <= endPage) {
+		uint16_t lastPage = page + PN5180ISO14443_FAST_READ_PAGES - 1;
+		if (lastPage > endPage) lastPage = endPage;
+		uint16_t len = 4 * (lastPage - page + 1);
+
+		cmd[0] = 0x3A;
+		cmd[1] = (uint8_t)page;
+		cmd[2] = (uint8_t)lastPage;
+		if (!transceiveFrame(cmd, 3, 0x00, false, PN5180ISO14443_RESPONSE_TIMEOUT + 86UL * len))
+		  return false;
+		// a NAK (4 bit) is returned for invalid pages
+		if (rxBytesReceived() != len)
+		  return false;
+		if (!readData(len, buffer))
+		  return false;
+
+		buffer += len;
+		page = lastPage + 1;
+	}
+	return true;
+}
+
+/*
+ * NTAG/Ultralight EV1 GET_VERSION, code=60
+ * version : 8 bytes, header, vendor ID, product type, product subtype,
+ *           major/minor product version, storage size, protocol type
+ */
+bool PN5180ISO14443::ntagGetVersion(uint8_t *version) {
+	uint8_t cmd[1] = { 0x60 };
+	if (!transceiveFrame(cmd, 1, 0x00))
+	  return false;
+	if (rxBytesReceived() != 8)
+	  return false;
+	return readData(8, version);
+}
+
+/*
+ * Number of pages of the tag from the storage size of GET_VERSION,
+ * 0 for unknown tags
+ */
+uint16_t PN5180ISO14443::ntagPageCount(const uint8_t *version) {
+	switch (version[6]) {
+		case 0x0B: return 20;  // NTAG210, Ultralight EV1 MF0UL11
+		case 0x0E: return 41;  // NTAG212, Ultralight EV1 MF0UL21
+		case 0x0F: return 45;  // NTAG213
+		case 0x11: return 135; // NTAG215
+		case 0x13: return 231; // NTAG216
+		default: return 0;
+	}
+}
+
+/*
+ * ISO-DEP frame sizes for FSDI/FSCI 0..8, larger values are limited to 256 bytes
+ */
+static const uint16_t isoDepFrameSizes[9] = { 16, 24, 32, 40, 48, 64, 96, 128, 256 };
+
+/*
+ * ISO-DEP waiting times: 302us (256*16/fc) * 2^FWI, FWI 0..14
+ */
+static uint32_t isoDepWaitingTime(uint8_t fwi) {
+	if (fwi > 14) fwi = 4;
+	return 302UL << fwi;
+}
+
+/*
+ * Activate ISO-DEP on a card selected by activateTypeA (SAK bit 0x20 set):
+ * RATS, ATS parsing (FSC, FWI, SFGI, supported bit rates) and PPS to the
+ * highest bit rate supported by the card up to maxBitRate (PN5180_ISODEP_xxx).
+ * ats : optional buffer for the ATS, atsSize its size
+ */
+bool PN5180ISO14443::isoDepActivate(uint8_t *ats, uint8_t atsSize, uint8_t maxBitRate) {
+	// FSDI for our frame size
+	uint8_t fsdi = 0;
+	// frames of the card have to fit into the receive buffer, too
+	uint16_t fsd = (getReadBufferSize() < PN5180_ISODEP_FRAME_SIZE) ? getReadBufferSize() : PN5180_ISODEP_FRAME_SIZE;
+	while ((fsdi < 8) && (isoDepFrameSizes[fsdi + 1] <= fsd)) fsdi++;
+
+	// defaults of ISO14443-4, if TA/TB are not present
+	uint8_t fsci = 2;
+	uint8_t fwi = 4;
+	uint8_t sfgi = 0;
+	uint8_t ta = 0;
+
+	isoDepBlockNumber = 0;
+	isoDepBitRate = PN5180_ISODEP_106;
+	isoDepActive = false;
+
+	//Send RATS, CID 0
+	uint8_t cmd[3];
+	cmd[0] = 0xE0;
+	cmd[1] = (uint8_t)(fsdi << 4);
+	if (!transceiveFrame(cmd, 2))
+	  return false;
+	uint16_t len = rxBytesReceived();
+	if ((len < 1) || (len > getReadBufferSize()))
+	  return false;
+	uint8_t *rx = readData(len);
+	if (!rx || (rx[0] != len))
+	  return false;
+	if (ats) {
+		for (uint16_t i = 0; (i < len) && (i < atsSize); i++) ats[i] = rx[i];
+	}
+
+	// TL, T0, TA, TB, TC, historical bytes; TL is the length of the ATS, the
+	// interface bytes announced by T0 have to be within it
+	if (len > 1) {
+		uint8_t t0 = rx[1];
+		uint8_t pos = 2;
+		uint8_t interfaceBytes = ((t0 >> 4) & 1) + ((t0 >> 5) & 1) + ((t0 >> 6) & 1);
+		if (pos + interfaceBytes > len) {
+			PN5180DEBUG(F("*** ERROR: ATS too short for T0\n"));
+			return false;
+		}
+		fsci = t0 & 0x0F;
+		if (t0 & 0x10) ta = rx[pos++];
+		if (t0 & 0x20) {
+			fwi = rx[pos] >> 4;
+			sfgi = rx[pos] & 0x0F;
+			pos++;
+		}
+		// TC and the historical bytes are not used
+	}
+	isoDepFsc = isoDepFrameSizes[(fsci > 8) ? 8 : fsci];
+	if (isoDepFsc > PN5180_ISODEP_FRAME_SIZE) isoDepFsc = PN5180_ISODEP_FRAME_SIZE;
+	isoDepFwt = isoDepWaitingTime(fwi);
+
+	PN5180DEBUG(F("ATS: FSC="));
+	PN5180DEBUG(isoDepFsc);
+	PN5180DEBUG(F(", FWT="));
+	PN5180DEBUG(isoDepFwt);
+	PN5180DEBUG(F("us, TA=0x"));
+	PN5180DEBUG(formatHex(ta));
+	PN5180DEBUG("\n");
+
+	// start-up frame guard time
+	if ((sfgi > 0) && (sfgi < 15)) {
+		uint32_t sfgt = isoDepWaitingTime(sfgi);
+		getHAL()->delayMs(sfgt / 1000);
+		getHAL()->delayUs(sfgt % 1000);
+	}
+
+	// highest bit rate supported in both directions (DS bits 4..6, DR bits 0..2)
+	uint8_t bitRate = PN5180_ISODEP_106;
+	for (uint8_t n = 1; n <= maxBitRate && n <= PN5180_ISODEP_848; n++) {
+		if ((ta & (1 << (n - 1))) && (ta & (1 << (n + 3)))) bitRate = n;
+	}
+	if (PN5180_ISODEP_106 == bitRate) {
+		isoDepActive = true;
+		return true;
+	}
+
+	//Send PPS, CID 0, DSI = DRI
+	cmd[0] = 0xD0;
+	cmd[1] = 0x11; // PPS1 present
+	cmd[2] = (uint8_t)((bitRate << 2) | bitRate);
+	if (!transceiveFrame(cmd, 3, 0x00, false, isoDepFwt))
+	  return false;
+	uint8_t ppsResponse;
+	if ((rxBytesReceived() != 1) || !readData(1, &ppsResponse) || (0xD0 != ppsResponse))
+	  return false;
+	// switch transmitter and receiver to the new bit rate
+	if (!loadRFConfig(bitRate, 0x80 + bitRate))
+	  return false;
+	isoDepBitRate = bitRate;
+	isoDepActive = true;
+
+	PN5180DEBUG(F("ISO-DEP bit rate: "));
+	PN5180DEBUG(106 << bitRate);
+	PN5180DEBUG(F("kbit/s\n"));
+	return true;
+}
+
+/*
+ * Send one block and receive the answer of the card, S(WTX) requests are
+ * answered and the waiting time extended. On a timeout or an invalid
+ * answer, up to 2 R(NAK) are sent, so the card repeats its last block
+ * (ISO 14443-4 rule 4). An I-block is only sent again if the card answers
+ * the R(NAK) with an R(ACK) of the other block number, i.e. it did not
+ * receive the I-block (rule 6). An R(ACK) without answer is repeated.
+ * rx points to the receive buffer of the PN5180 instance.
+ */
+bool PN5180ISO14443::isoDepExchange(uint8_t *frame, uint16_t len, uint8_t **rx, uint16_t *rxLen) {
+	uint32_t timeoutUs = isoDepFwt + PN5180ISO14443_RESPONSE_TIMEOUT;
+	uint8_t wtx[2];
+	uint8_t nak[1];
+	uint8_t *txFrame = frame;
+	uint16_t txLen = len;
+	bool iBlock = (0x02 == (frame[0] & 0xE2));
+
+	for (uint8_t attempt = 0; attempt < 3; ) {
+		bool success = transceiveFrame(txFrame, txLen, 0x00, false, timeoutUs);
+		uint32_t rxStatus = 0;
+		if (success)
+		  success = readRegister(RX_STATUS, &rxStatus) &&
+		            (0 == (rxStatus & (RX_DATA_INTEGRITY_ERROR | RX_PROTOCOL_ERROR | RX_COLLISION_DETECTED)));
+		*rxLen = (uint16_t)(rxStatus & RX_BYTES_RECEIVED_MASK);
+		if (!success || (0 == *rxLen)) {
+			timeoutUs = isoDepFwt + PN5180ISO14443_RESPONSE_TIMEOUT;
+			attempt++;
+			if (iBlock) {
+				// the card may have executed the I-block, it must not be sent again
+				PN5180DEBUG(F("ISO-DEP: no answer, R(NAK)\n"));
+				nak[0] = 0xB2 | isoDepBlockNumber;
+				txFrame = nak;
+				txLen = 1;
+			}
+			else {
+				PN5180DEBUG(F("ISO-DEP: no answer, retransmit\n"));
+				txFrame = frame;
+				txLen = len;
+			}
+			continue;
+		}
+		*rx = readData(*rxLen);
+		if (!*rx)
+		  return false;
+		if ((txFrame == nak) && (0xA2 == ((*rx)[0] & 0xF6)) && (((*rx)[0] & 0x01) != isoDepBlockNumber)) {
+			// the I-block did not reach the card
+			PN5180DEBUG(F("ISO-DEP: I-block not received, retransmit\n"));
+			txFrame = frame;
+			txLen = len;
+			continue;
+		}
+		if ((0xF2 == ((*rx)[0] & 0xF7)) && (*rxLen >= 2)) {
+			// S(WTX) request, answer with the same WTXM and wait FWT * WTXM
+			uint8_t wtxm = (*rx)[1] & 0x3F;
+			if (0 == wtxm) wtxm = 1;
+			PN5180DEBUG(F("ISO-DEP: WTX "));
+			PN5180DEBUG(wtxm);
+			PN5180DEBUG("\n");
+			wtx[0] = 0xF2;
+			wtx[1] = wtxm;
+			txFrame = wtx;
+			txLen = 2;
+			timeoutUs = isoDepFwt * wtxm + PN5180ISO14443_RESPONSE_TIMEOUT;
+			continue;
+		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Send an APDU with ISO-DEP I-blocks and receive the answer. APDUs larger
+ * than the frame size of the card (FSC) are sent with chaining, chained
+ * answers are acknowledged with R(ACK) and put together.
+ * return value: length of the response, -1 on error
+ */
+int16_t PN5180ISO14443::isoDepTransceive(const uint8_t *apdu, uint16_t apduLen, uint8_t *response, uint16_t responseSize) {
+	uint8_t frame[PN5180_ISODEP_FRAME_SIZE];
+	// PCB and CRC are part of the frame
+	uint16_t maxInf = isoDepFsc - 3;
+	uint8_t *rx;
+	uint16_t rxLen;
+
+	// send the APDU, chained if necessary
+	uint16_t pos = 0;
+	for (;;) {
+		uint16_t chunk = apduLen - pos;
+		bool chaining = (chunk > maxInf);
+		if (chaining) chunk = maxInf;
+		frame[0] = 0x02 | isoDepBlockNumber | (chaining ? 0x10 : 0x00); // I-block
+		for (uint16_t i = 0; i < chunk; i++) frame[1 + i] = apdu[pos + i];
+		if (!isoDepExchange(frame, 1 + chunk, &rx, &rxLen))
+		  return -1;
+		pos += chunk;
+		if (!chaining)
+		  break;
+		// R(ACK) with our block number acknowledges the chained block
+		if ((0xA2 != (rx[0] & 0xF6)) || ((rx[0] & 0x01) != isoDepBlockNumber))
+		  return -1;
+		isoDepBlockNumber ^= 1;
+	}
+
+	// receive the answer, chained if necessary
+	uint16_t responseLen = 0;
+	for (;;) {
+		// I-block with the current block number expected
+		if ((0x02 != (rx[0] & 0xE2)) || ((rx[0] & 0x01) != isoDepBlockNumber)) {
+			PN5180DEBUG(F("ISO-DEP: unexpected block\n"));
+			return -1;
+		}
+		isoDepBlockNumber ^= 1;
+		for (uint16_t i = 1; i < rxLen; i++) {
+			if (responseLen >= responseSize)
+			  return -1;
+			response[responseLen++] = rx[i];
+		}
+		if (0 == (rx[0] & 0x10))
+		  break;
+		// acknowledge the chained block
+		frame[0] = 0xA2 | isoDepBlockNumber; // R(ACK)
+		if (!isoDepExchange(frame, 1, &rx, &rxLen))
+		  return -1;
+	}
+	return (int16_t)responseLen;
+}
+
+/*
+ * Send S(DESELECT) and return to 106 kbit/s
+ */
+bool PN5180ISO14443::isoDepDeselect() {
+	uint8_t cmd[1] = { 0xC2 };
+	isoDepActive = false;
+	bool success = transceiveFrame(cmd, 1, 0x00, false, isoDepFwt + PN5180ISO14443_RESPONSE_TIMEOUT) &&
+	               (1 == rxBytesReceived());
+	if (PN5180_ISODEP_106 != isoDepBitRate) {
+		success = loadRFConfig(0x00, 0x80) && success;
+		isoDepBitRate = PN5180_ISODEP_106;
+	}
+	return success;
 }
 
 bool PN5180ISO14443::mifareHalt() {
@@ -218,20 +705,40 @@ bool PN5180ISO14443::mifareHalt() {
 	//mifare Halt
 	cmd[0] = 0x50;
 	cmd[1] = 0x00;
-	sendData(cmd, 2, 0x00);	
+	beginRegisterBatch();
+	clearIRQStatus(TX_IRQ_STAT);
+	bool success = sendData(cmd, 2, 0x00);
+	if (!endRegisterBatch() || !success)
+	  return false;
+	// the card does not answer, wait until the frame is sent completely
+	// before the transceiver is stopped by the next command
+	waitForIRQ(TX_IRQ_STAT, PN5180ISO14443_RESPONSE_TIMEOUT);
 	return true;
 }
 
+/*
+ * Copies 7 bytes to buffer as before triple size UIDs were supported, use
+ * readCardSerial(buffer, 10) for 10 byte UIDs
+ */
 uint8_t PN5180ISO14443::readCardSerial(uint8_t *buffer) {
+	return readCardSerial(buffer, 7);
+}
+
+/*
+ * bufferSize : number of UID bytes copied to buffer, max. 10,
+ *              the bytes after the UID are zero
+ */
+uint8_t PN5180ISO14443::readCardSerial(uint8_t *buffer, uint8_t bufferSize) {
   
-    uint8_t response[10];
+    uint8_t response[13];
 	uint8_t uidLength;
 	// Always return 10 bytes
     // Offset 0..1 is ATQA
     // Offset 2 is SAK.
-    // UID 4 bytes : offset 3 to 6 is UID, offset 7 to 9 to Zero
-    // UID 7 bytes : offset 3 to 9 is UID
-    for (int i = 0; i < 10; i++) response[i] = 0;
+    // UID 4 bytes : offset 3 to 6 is UID, offset 7 to 12 to Zero
+    // UID 7 bytes : offset 3 to 9 is UID, offset 10 to 12 to Zero
+    // UID 10 bytes : offset 3 to 12 is UID
+    for (int i = 0; i < 13; i++) response[i] = 0;
     uidLength = activateTypeA(response, 1);
 	if (uidLength == 0)
 	  return 0;
@@ -242,13 +749,191 @@ uint8_t PN5180ISO14443::readCardSerial(uint8_t *buffer) {
 	  uidLength = 0;
 	if ((response[3] == 0xFF) && (response[4] == 0xFF) && (response[5] == 0xFF) && (response[6] == 0xFF))
 	  uidLength = 0;
-    for (int i = 0; i < 7; i++) buffer[i] = response[i+3];
+    if (bufferSize > 10) bufferSize = 10;
+    for (int i = 0; i < bufferSize; i++) buffer[i] = response[i+3];
 	mifareHalt();
 	return uidLength;  
 }
 
+/*
+ * Read the UIDs of all cards in the field within one RF session. Each card
+ * is activated with REQA and put to HALT state afterwards, so it does not
+ * answer again, until no more card answers.
+ * uids : maxCards * 10 bytes, uidLengths : maxCards bytes
+ * return value: number of cards found
+ */
+uint8_t PN5180ISO14443::readAllCardSerials(uint8_t *uids, uint8_t *uidLengths, uint8_t maxCards) {
+	uint8_t response[13];
+	uint8_t numCards = 0;
+	while (numCards < maxCards) {
+		for (int i = 0; i < 13; i++) response[i] = 0;
+		uint8_t uidLength = activateTypeA(response, 0);
+		if (uidLength == 0)
+		  break;
+		for (int i = 0; i < 10; i++) uids[10*numCards + i] = response[i+3];
+		uidLengths[numCards++] = uidLength;
+		mifareHalt();
+	}
+	return numCards;
+}
+
 bool PN5180ISO14443::isCardPresent() {
+	if (trackedUidLength > 0)
+	  return checkPresence();
     uint8_t buffer[10];
 	return (readCardSerial(buffer) >=4);
 }
 
+/*
+ * Wake up a halted card with WUPA and select it with its known UID,
+ * without anticollision. Returns the SAK of the last cascade level.
+ */
+bool PN5180ISO14443::wakeupSelect(uint8_t *uid, uint8_t uidLength, uint8_t *sak) {
+	uint8_t cmd[7];
+	if ((uidLength != 4) && (uidLength != 7) && (uidLength != 10))
+	  return false;
+	if (!loadRFConfig(0x0, 0x80)) 
+	  return false;
+
+	beginRegisterBatch();
+	// OFF Crypto
+	writeRegisterWithAndMask(SYSTEM_CONFIG, 0xFFFFFFBF);
+	// Clear RX CRC
+	writeRegisterWithAndMask(CRC_RX_CONFIG, 0xFFFFFFFE);
+	// Clear TX CRC
+	writeRegisterWithAndMask(CRC_TX_CONFIG, 0xFFFFFFFE);
+	//Send WUPA, 7 bits in last byte
+	cmd[0] = 0x52;
+	bool success = transceiveFrame(cmd, 1, 0x07);
+	if (success) {
+		//Enable RX CRC calculation
+		writeRegisterWithOrMask(CRC_RX_CONFIG, 0x01);
+		//Enable TX CRC calculation
+		writeRegisterWithOrMask(CRC_TX_CONFIG, 0x01);
+	}
+	// Select on each cascade level, CT + 3 bytes UID or the last 4 bytes
+	uint8_t pos = 0;
+	for (uint8_t level = 0; success && level < 3; level++) {
+		bool last = (uidLength - pos == 4);
+		cmd[0] = 0x93 + 2*level;
+		cmd[1] = 0x70;
+		if (last) {
+			for (int i = 0; i < 4; i++) cmd[2 + i] = uid[pos++];
+		}
+		else {
+			cmd[2] = 0x88;
+			for (int i = 0; i < 3; i++) cmd[3 + i] = uid[pos++];
+		}
+		cmd[6] = cmd[2] ^ cmd[3] ^ cmd[4] ^ cmd[5]; // BCC
+		success = transceiveFrame(cmd, 7, 0x00, true) && readData(1, sak);
+		if (last)
+		  break;
+		// SAK must announce the next cascade level
+		if (success && (0 == (*sak & 0x04)))
+		  success = false;
+	}
+	return endRegisterBatch() && success;
+}
+
+/*
+ * Activate a card and keep it selected for presence tracking. Following
+ * calls of checkPresence() (or isCardPresent()) confirm that the card is
+ * still in the field, see there.
+ * uid : optional 10 byte buffer for the UID of the card
+ * onRemoved : called by checkPresence(), when the card has been removed
+ * return value: the uid length, 0 if no card was found
+ */
+uint8_t PN5180ISO14443::startPresenceTracking(uint8_t *uid, PN5180CardRemovedCallback onRemoved, void *arg) {
+	uint8_t response[13];
+	for (int i = 0; i < 13; i++) response[i] = 0;
+	trackedUidLength = 0;
+	uint8_t uidLength = activateTypeA(response, 1);
+	if (uidLength == 0)
+	  return 0;
+	// check for valid uid
+	if ((response[3] == 0x00) && (response[4] == 0x00) && (response[5] == 0x00) && (response[6] == 0x00))
+	  return 0;
+	if ((response[3] == 0xFF) && (response[4] == 0xFF) && (response[5] == 0xFF) && (response[6] == 0xFF))
+	  return 0;
+
+	for (int i = 0; i < 10; i++) trackedUid[i] = response[i+3];
+	if (uid) {
+		for (int i = 0; i < 10; i++) uid[i] = trackedUid[i];
+	}
+	trackedUidLength = uidLength;
+	trackedSak = response[2];
+	removedCallback = onRemoved;
+	removedCallbackArg = arg;
+	return uidLength;
+}
+
+/*
+ * Check if the tracked card is still in the field:
+ * - cards with SAK 0 (NFC Type 2, e.g. NTAG/Ultralight) stay selected and
+ *   are asked with a READ of page 0
+ * - other cards (e.g. MIFARE Classic) are halted and selected again with
+ *   WUPA and the known UID, without anticollision
+ * - between isoDepActivate() and isoDepDeselect(), an R(NAK) with the
+ *   current block number is sent, the card answers with R(ACK) (ISO14443-4
+ *   rule 12) and the block numbers are unchanged. Without answer, the
+ *   ISO-DEP state is reset to 106 kbit/s before the removal is reported
+ * A failed check is retried once, with halt and select for the cards
+ * without ISO-DEP. If the card does not answer, tracking stops and the
+ * removal callback is called.
+ * A MIFARE Classic card only accepts encrypted frames after
+ * authentication, presence checks should be done between authentications.
+ */
+bool PN5180ISO14443::checkPresence() {
+	if (0 == trackedUidLength)
+	  return false;
+
+	bool present = false;
+	for (uint8_t attempt = 0; !present && attempt < 2; attempt++) {
+		if (isoDepActive) {
+			uint8_t nak[1] = { (uint8_t)(0xB2 | isoDepBlockNumber) };
+			uint8_t ack;
+			present = transceiveFrame(nak, 1, 0x00, false, isoDepFwt + PN5180ISO14443_RESPONSE_TIMEOUT) &&
+			          (1 == rxBytesReceived()) && readData(1, &ack) && (0xA2 == (ack & 0xF6));
+		}
+		else if ((0 == attempt) && (0 == trackedSak)) {
+			uint8_t cmd[2] = { 0x30, 0x00 }; // READ page 0
+			present = transceiveFrame(cmd, 2) && (16 == rxBytesReceived());
+		}
+		else {
+			uint8_t sak;
+			present = mifareHalt() && wakeupSelect(trackedUid, trackedUidLength, &sak) &&
+			          (sak == trackedSak);
+		}
+	}
+	if (present)
+	  return true;
+
+	PN5180DEBUG(F("Tracked card removed\n"));
+	if (isoDepActive) {
+		isoDepActive = false;
+		isoDepBlockNumber = 0;
+		if (PN5180_ISODEP_106 != isoDepBitRate) {
+			loadRFConfig(0x00, 0x80);
+			isoDepBitRate = PN5180_ISODEP_106;
+		}
+	}
+	uint8_t uid[10];
+	uint8_t uidLength = trackedUidLength;
+	for (int i = 0; i < 10; i++) uid[i] = trackedUid[i];
+	PN5180CardRemovedCallback callback = removedCallback;
+	void *arg = removedCallbackArg;
+	stopPresenceTracking();
+	if (callback)
+	  callback(uid, uidLength, arg);
+	return false;
+}
+
+void PN5180ISO14443::stopPresenceTracking() {
+	trackedUidLength = 0;
+	removedCallback = 0;
+}
+
+bool PN5180ISO14443::isPresenceTracking() {
+	return (trackedUidLength > 0);
+}
+
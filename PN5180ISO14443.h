@@ -21,26 +21,88 @@
 
 #include "PN5180.h"
 
-class PN5180ISO14443 : public PN5180 {
+// max. time to wait for the response of a card, in us
+#define PN5180ISO14443_RESPONSE_TIMEOUT  5000
+// max. time for programming, e.g. the ACK of a MIFARE write, in us
+#define PN5180ISO14443_WRITE_TIMEOUT     10000
+// max. number of pages read by one FAST_READ, limited by the 508 byte receive buffer
+#define PN5180ISO14443_FAST_READ_PAGES   127
+
+// ISO-DEP (ISO14443-4) bit rates, RF configuration 0x00..0x03/0x80..0x83
+#define PN5180_ISODEP_106 0
+#define PN5180_ISODEP_212 1
+#define PN5180_ISODEP_424 2
+#define PN5180_ISODEP_848 3
+// max. ISO-DEP frame size (FSD/FSC), frames are built on the stack
+#ifndef PN5180_ISODEP_FRAME_SIZE
+#define PN5180_ISODEP_FRAME_SIZE 256
+#endif
+
+// PN5180 is a virtual base, so PN5180Discovery can combine both protocols on one module.
+// Subclasses have to call a PN5180 constructor in their own initializer list.
+class PN5180ISO14443 : public virtual PN5180 {
 
 public:
-  PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin);
+  PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi = SPI);
+  PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi = SPI);
+  PN5180ISO14443(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal);
   
 private:
+  // card tracked by checkPresence(), uidLength 0 = none
+  uint8_t trackedUid[10];
+  uint8_t trackedUidLength;
+  uint8_t trackedSak;
+  PN5180CardRemovedCallback removedCallback;
+  void *removedCallbackArg;
+
   uint16_t rxBytesReceived();
+  bool transceiveFrame(uint8_t *data, int len, uint8_t validBits = 0, bool continueCycle = false,
+                       uint32_t timeoutUs = PN5180ISO14443_RESPONSE_TIMEOUT);
+  bool anticollision(uint8_t sel, uint8_t *uid);
+  bool wakeupSelect(uint8_t *uid, uint8_t uidLength, uint8_t *sak);
+
+  // ISO-DEP state, see isoDepActivate()
+  uint8_t isoDepBlockNumber;
+  uint16_t isoDepFsc;
+  uint32_t isoDepFwt;
+  uint8_t isoDepBitRate;
+  bool isoDepActive;       // between isoDepActivate() and isoDepDeselect()
+  bool isoDepExchange(uint8_t *frame, uint16_t len, uint8_t **rx, uint16_t *rxLen);
 public:
   // Mifare TypeA
   uint8_t activateTypeA(uint8_t *buffer, uint8_t kind);
   bool mifareBlockRead(uint8_t blockno,uint8_t *buffer);
   uint8_t mifareBlockWrite16(uint8_t blockno, uint8_t *buffer);
   bool mifareHalt();
+  bool readSector(uint8_t sector, const uint8_t *key, uint8_t keyType, const uint8_t *uid, uint8_t uidLength, uint8_t *buffer);
+  static uint8_t sectorFirstBlock(uint8_t sector);
+  static uint8_t sectorBlockCount(uint8_t sector);
+  // NTAG/MIFARE Ultralight
+  uint8_t ntagWrite(uint8_t page, const uint8_t *data);
+  bool ntagFastRead(uint8_t startPage, uint8_t endPage, uint8_t *buffer);
+  bool ntagGetVersion(uint8_t *version);
+  static uint16_t ntagPageCount(const uint8_t *version);
+  // ISO-DEP (ISO14443-4), for cards with SAK bit 0x20 set
+  bool isoDepActivate(uint8_t *ats = 0, uint8_t atsSize = 0, uint8_t maxBitRate = PN5180_ISODEP_848);
+  int16_t isoDepTransceive(const uint8_t *apdu, uint16_t apduLen, uint8_t *response, uint16_t responseSize);
+  bool isoDepDeselect();
   /*
    * Helper functions
    */
 public:   
   bool setupRF();
   uint8_t readCardSerial(uint8_t *buffer);    
+  uint8_t readCardSerial(uint8_t *buffer, uint8_t bufferSize);
+  uint8_t readAllCardSerials(uint8_t *uids, uint8_t *uidLengths, uint8_t maxCards);
   bool isCardPresent();    
+  /*
+   * Presence tracking of an activated card, see checkPresence()
+   */
+public:
+  uint8_t startPresenceTracking(uint8_t *uid = 0, PN5180CardRemovedCallback onRemoved = 0, void *arg = 0);
+  bool checkPresence();
+  void stopPresenceTracking();
+  bool isPresenceTracking();
 };
 
 #endif /* PN5180ISO14443_H */
@@ -22,8 +22,32 @@
 #include "PN5180ISO15693.h"
 #include "Debug.h"
 
-PN5180ISO15693::PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin) 
-              : PN5180(SSpin, BUSYpin, RSTpin) {
+// ISO15693 response timing at high data rate, in us, x4 at low data rate
+// 1 out of 4 coding, 75.52us per 2 bits (VCD -> VICC)
+#define PN5180ISO15693_TX_BYTE_TIME      302
+// t1 max. is 323us, plus margin for detecting the SOF
+#define PN5180ISO15693_SOF_TIMEOUT       1000
+// write/lock commands are answered after programming, max. 20ms
+#define PN5180ISO15693_WRITE_SOF_TIMEOUT 21000
+// 37.76us per bit (VICC -> VCD, single subcarrier)
+#define PN5180ISO15693_RX_BYTE_TIME      302
+
+PN5180ISO15693::PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi) 
+              : PN5180(SSpin, BUSYpin, RSTpin, spi) {
+  tracking = false;
+  removedCallback = 0;
+}
+
+PN5180ISO15693::PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi) 
+              : PN5180(SSpin, BUSYpin, RSTpin, IRQpin, spi) {
+  tracking = false;
+  removedCallback = 0;
+}
+
+PN5180ISO15693::PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal) 
+              : PN5180(SSpin, BUSYpin, RSTpin, IRQpin, hal) {
+  tracking = false;
+  removedCallback = 0;
 }
 
 /*
@@ -69,6 +93,227 @@ ISO15693ErrorCode PN5180ISO15693::getInventory(uint8_t *uid) {
   return ISO15693_EC_OK;
 }
 
+/*
+ * Start presence tracking of the tag in the field (1 slot inventory)
+ * uid : optional 8 byte buffer for the UID of the tag
+ * onRemoved : called by checkPresence(), when the tag has been removed
+ */
+ISO15693ErrorCode PN5180ISO15693::startPresenceTracking(uint8_t *uid, PN5180CardRemovedCallback onRemoved, void *arg) {
+  tracking = false;
+  ISO15693ErrorCode rc = getInventory(trackedUid);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
+  if (uid) {
+    for (int i=0; i<8; i++) uid[i] = trackedUid[i];
+  }
+  tracking = true;
+  removedCallback = onRemoved;
+  removedCallbackArg = arg;
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Check if the tracked tag is still in the field: a 1 slot inventory with
+ * the complete UID as mask (64 bits), only the tracked tag answers, even if
+ * other tags are in the field. A failed check is retried once, then tracking
+ * stops and the removal callback is called.
+ */
+bool PN5180ISO15693::checkPresence() {
+  if (!tracking) {
+    return false;
+  }
+  //                     Flags,  CMD, maskLen, mask
+  uint8_t inventory[] = { 0x26, 0x01, 64, 1,2,3,4,5,6,7,8 }; // UID has LSB first!
+  for (int i=0; i<8; i++) {
+    inventory[3+i] = trackedUid[i];
+  }
+
+  for (uint8_t attempt=0; attempt<2; attempt++) {
+    uint8_t *readBuffer;
+    if ((ISO15693_EC_OK == issueISO15693Command(inventory, sizeof(inventory), &readBuffer)) &&
+        (0 == memcmp(&readBuffer[2], trackedUid, 8))) {
+      return true;
+    }
+  }
+
+  PN5180DEBUG(F("Tracked tag removed\n"));
+  uint8_t uid[8];
+  memcpy(uid, trackedUid, 8);
+  PN5180CardRemovedCallback callback = removedCallback;
+  void *arg = removedCallbackArg;
+  stopPresenceTracking();
+  if (callback) {
+    callback(uid, 8, arg);
+  }
+  return false;
+}
+
+void PN5180ISO15693::stopPresenceTracking() {
+  tracking = false;
+  removedCallback = 0;
+}
+
+bool PN5180ISO15693::isPresenceTracking() {
+  return tracking;
+}
+
+/*
+ * Any tag in the field? Checks the tracked tag only, if presence tracking is active
+ */
+bool PN5180ISO15693::isCardPresent() {
+  if (tracking) {
+    return checkPresence();
+  }
+  uint8_t uid[8];
+  return (ISO15693_EC_OK == getInventory(uid));
+}
+
+/*
+ * Inventory with 16 slots and anticollision, code=01
+ *
+ * Request format: SOF, Req.Flags, Inventory, Mask len, Mask value, CRC16, EOF
+ * Response format per slot: SOF, Resp.Flags, DSFID, UID, CRC16, EOF
+ *
+ * Each VICC matching the mask answers in the slot given by the next 4 bits of
+ * its UID. The reader switches to the next slot by sending an EOF only. Slots
+ * with a collision are resolved by repeating the inventory with the mask
+ * extended by the slot number, until all UIDs are read.
+ *
+ * uids: buffer for maxTags UIDs of 8 bytes each, LSB first
+ * numTags: number of UIDs found
+ */
+ISO15693ErrorCode PN5180ISO15693::getInventoryMultiple(uint8_t *uids, uint8_t maxTags, uint8_t *numTags) {
+  PN5180DEBUG(F("Get Inventory with 16 slots...\n"));
+
+  // pending masks: 1 byte mask length (bits) followed by 8 bytes mask value
+  uint8_t collisionMasks[PN5180_ISO15693_MAX_COLLISIONS * 9];
+  uint8_t numCollisions = 1;
+  memset(collisionMasks, 0, 9); // start with empty mask
+
+  ISO15693ErrorCode rc = ISO15693_EC_OK;
+  *numTags = 0;
+  while (numCollisions > 0 && *numTags < maxTags) {
+    numCollisions--;
+    uint8_t entry[9];
+    memcpy(entry, &collisionMasks[9*numCollisions], 9);
+    rc = inventoryRound(entry[0], &entry[1], uids, maxTags, numTags, collisionMasks, &numCollisions);
+    if (ISO15693_EC_OK != rc && EC_NO_CARD != rc) {
+      return rc;
+    }
+  }
+
+  PN5180DEBUG(F("Tags found: "));
+  PN5180DEBUG(*numTags);
+  PN5180DEBUG("\n");
+
+  return (*numTags > 0) ? ISO15693_EC_OK : EC_NO_CARD;
+}
+
+/*
+ * One 16 slot inventory round with the given mask. UIDs read are appended to
+ * uids, masks for slots with collision are appended to collisionMasks.
+ */
+ISO15693ErrorCode PN5180ISO15693::inventoryRound(uint8_t maskLen, uint8_t *mask, uint8_t *uids, uint8_t maxTags, uint8_t *numTags,
+                                                 uint8_t *collisionMasks, uint8_t *numCollisions) {
+  //                     Flags,  CMD, maskLen, mask (max. 8 bytes)
+  uint8_t inventory[11] = { 0x06, 0x01, maskLen };
+  //                          |\- inventory flag + high data rate
+  //                          \-- 16 slots, no AFI field present
+  uint8_t maskBytes = (maskLen + 7) / 8;
+  memcpy(&inventory[3], mask, maskBytes);
+
+  // TX_CONFIG is changed to send EOF only for switching slots
+  uint32_t txConfig;
+  if (!readRegister(TX_CONFIG, &txConfig)) {
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+
+  ISO15693ErrorCode rc = EC_NO_CARD;
+  for (uint8_t slot=0; slot<16; slot++) {
+    beginRegisterBatch();
+    clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | RX_SOF_DET_IRQ_STAT);
+    if (1 == slot) {
+      writeRegisterWithAndMask(TX_CONFIG, 0xFFFFFB3F); // send EOF only
+    }
+    bool success = sendData(inventory, (0 == slot) ? 3 + maskBytes : 0);
+    if (!endRegisterBatch() || !success) {
+      rc = ISO15693_EC_UNKNOWN_ERROR;
+      break;
+    }
+
+    uint32_t irqStatus = waitForResponse(10000, 1000, 20000);
+    if (0 == (irqStatus & RX_IRQ_STAT)) {
+      if (irqStatus & RX_SOF_DET_IRQ_STAT) { // answer started, but not completed
+        PN5180DEBUG(F("Incomplete response in slot "));
+        PN5180DEBUG(slot);
+        PN5180DEBUG("\n");
+      }
+      continue; // empty slot
+    }
+
+    uint32_t rxStatus;
+    readRegister(RX_STATUS, &rxStatus);
+    uint16_t len = (uint16_t)(rxStatus & RX_BYTES_RECEIVED_MASK);
+
+    if ((rxStatus & (RX_COLLISION_DETECTED | RX_DATA_INTEGRITY_ERROR)) || len < 10) {
+      PN5180DEBUG(F("Collision in slot "));
+      PN5180DEBUG(slot);
+      PN5180DEBUG("\n");
+      if (maskLen + 4 > 64 || *numCollisions >= PN5180_ISO15693_MAX_COLLISIONS) {
+        PN5180DEBUG(F("*** ERROR: Too many collisions!\n"));
+        continue;
+      }
+      uint8_t *entry = &collisionMasks[9 * (*numCollisions)++];
+      memset(entry, 0, 9);
+      entry[0] = maskLen + 4;
+      memcpy(&entry[1], mask, maskBytes);
+      entry[1 + maskLen/8] |= slot << (maskLen % 8);
+      continue;
+    }
+
+    uint8_t response[10];
+    if (!readData(10, response)) {
+      rc = ISO15693_EC_UNKNOWN_ERROR;
+      break;
+    }
+    if (response[0] & 0x01) { // error flag
+      continue;
+    }
+    if (*numTags < maxTags) {
+      memcpy(&uids[8 * (*numTags)++], &response[2], 8);
+      rc = ISO15693_EC_OK;
+    }
+  }
+
+  writeRegister(TX_CONFIG, txConfig);
+  clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | RX_SOF_DET_IRQ_STAT);
+  return rc;
+}
+
+/*
+ * Wait for the response of a VICC: first for the end of the own transmission,
+ * then for the start of the response (SOF). If a SOF was detected, wait for the
+ * end of the reception. Returns the last IRQ status, without RX_IRQ_STAT set, if
+ * no complete response was received.
+ * TX_IRQ_STAT stays set until the response is read, each waitForIRQ() enables
+ * only its own flags, so with an IRQ pin the line is low again during the
+ * SOF and RX waits and IRQ_STATUS is not polled over SPI.
+ */
+uint32_t PN5180ISO15693::waitForResponse(uint32_t txTimeoutUs, uint32_t sofTimeoutUs, uint32_t rxTimeoutUs) {
+  uint32_t irqStatus = waitForIRQ(TX_IRQ_STAT, txTimeoutUs);
+  if (0 == (irqStatus & TX_IRQ_STAT)) {
+    return irqStatus;
+  }
+  if (0 == (irqStatus & (RX_SOF_DET_IRQ_STAT | RX_IRQ_STAT))) {
+    irqStatus = waitForIRQ(RX_SOF_DET_IRQ_STAT | RX_IRQ_STAT, sofTimeoutUs);
+  }
+  if ((irqStatus & RX_SOF_DET_IRQ_STAT) && 0 == (irqStatus & RX_IRQ_STAT)) {
+    irqStatus = waitForIRQ(RX_IRQ_STAT, rxTimeoutUs);
+  }
+  return irqStatus;
+}
+
 /*
  * Read single block, code=20
  *
@@ -112,23 +357,25 @@ ISO15693ErrorCode PN5180ISO15693::readSingleBlock(uint8_t *uid, uint8_t blockNo,
   PN5180DEBUG(", size=");
   PN5180DEBUG(blockSize);
   PN5180DEBUG(": ");
-  for (int i=0; i<sizeof(readSingleBlock); i++) {
-    PN5180DEBUG(" ");
-    PN5180DEBUG(formatHex(readSingleBlock[i]));
-  }
+  PN5180DEBUG_HEX(readSingleBlock, sizeof(readSingleBlock));
   PN5180DEBUG("\n");
 #endif
 
   uint8_t *resultPtr;
-  ISO15693ErrorCode rc = issueISO15693Command(readSingleBlock, sizeof(readSingleBlock), &resultPtr);
+  uint16_t resultLen;
+  ISO15693ErrorCode rc = issueISO15693Command(readSingleBlock, sizeof(readSingleBlock), &resultPtr, &resultLen);
   if (ISO15693_EC_OK != rc) {
     return rc;
   }
+  if (resultLen < 1 + blockSize) {
+    PN5180DEBUG(F("*** ERROR: Read Single Block response too short!\n"));
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
 
   PN5180DEBUG("Value=");
   
   for (int i=0; i<blockSize; i++) {
-    blockData[i] = resultPtr[2+i];
+    blockData[i] = resultPtr[1+i];
 #ifdef DEBUG    
     PN5180DEBUG(formatHex(blockData[i]));
     PN5180DEBUG(" ");
@@ -184,8 +431,14 @@ ISO15693ErrorCode PN5180ISO15693::writeSingleBlock(uint8_t *uid, uint8_t blockNo
   //                               |\- high data rate
   //                               \-- no options, addressed by UID
 
+  if (blockSize > PN5180_ISO15693_MAX_BLOCK_SIZE) {
+    PN5180DEBUG(F("ERROR: Block size exceeds PN5180_ISO15693_MAX_BLOCK_SIZE!\n"));
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+
+  // command frame is built on the stack, no heap allocation per block
+  uint8_t writeCmd[sizeof(writeSingleBlock) + PN5180_ISO15693_MAX_BLOCK_SIZE];
   uint8_t writeCmdSize = sizeof(writeSingleBlock) + blockSize;
-  uint8_t *writeCmd = (uint8_t*)malloc(writeCmdSize);
   uint8_t pos = 0;
   writeCmd[pos++] = writeSingleBlock[0];
   writeCmd[pos++] = writeSingleBlock[1];
@@ -202,22 +455,163 @@ ISO15693ErrorCode PN5180ISO15693::writeSingleBlock(uint8_t *uid, uint8_t blockNo
   PN5180DEBUG(blockNo);
   PN5180DEBUG(", size=");
   PN5180DEBUG(blockSize);
-  PN5180DEBUG(":");
-  for (int i=0; i<writeCmdSize; i++) {
-    PN5180DEBUG(" ");
-    PN5180DEBUG(formatHex(writeCmd[i]));
-  }
+  PN5180DEBUG(": ");
+  PN5180DEBUG_HEX(writeCmd, writeCmdSize);
   PN5180DEBUG("\n");
 #endif
 
   uint8_t *resultPtr;
-  ISO15693ErrorCode rc = issueISO15693Command(writeCmd, writeCmdSize, &resultPtr);
-  if (ISO15693_EC_OK != rc) {
-    free(writeCmd);
-    return rc;
+  return issueISO15693Command(writeCmd, writeCmdSize, &resultPtr);
+}
+
+/*
+ * Read multiple blocks, code=23
+ *
+ * Request format: SOF, Req.Flags, ReadMultipleBlock, UID (opt.), FirstBlockNumber, NumBlocks-1, CRC16, EOF
+ * Response format:
+ *  when ERROR flag is set:
+ *    SOF, Resp.Flags, ErrorCode, CRC16, EOF
+ *
+ *  when ERROR flag is NOT set:
+ *    SOF, Flags, BlockData (len=blockSize*numBlocks), CRC16, EOF
+ *
+ * The request is split into several commands automatically, so that each
+ * response fits into the receive buffer (getReadBufferSize()).
+ * blockData must hold numBlocks*blockSize bytes, numBlocks may be up to 256.
+ */
+ISO15693ErrorCode PN5180ISO15693::readMultipleBlocks(uint8_t *uid, uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize) {
+  //                               header, flags, cmd, uid,             firstBlock, numBlocks-1
+  uint8_t readMultipleBlock[] = { 0, 0,   0x22, 0x23, 1,2,3,4,5,6,7,8, 0, 0 }; // UID has LSB first!
+  //                                        |\- high data rate
+  //                                        \-- no options, addressed by UID
+  for (int i=0; i<8; i++) {
+    readMultipleBlock[4+i] = uid[i];
+  }
+  return readMultipleBlocksFrame(readMultipleBlock, firstBlock, numBlocks, blockData, blockSize);
+}
+
+/*
+ * Chunked Read Multiple Blocks with a frame prepared for sendDataFrame()
+ * (14 bytes, the block parameters at offset 12 and 13), shared with
+ * PN5180ISO15693::Session
+ */
+ISO15693ErrorCode PN5180ISO15693::readMultipleBlocksFrame(uint8_t *frame, uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize) {
+  if ((0 == blockSize) || (0 == numBlocks) || (firstBlock + numBlocks > 256)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  // one byte response flags precede the block data
+  uint16_t maxBlocks = (getReadBufferSize() - 1) / blockSize;
+  if (0 == maxBlocks) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  uint16_t blockNo = firstBlock;
+  uint16_t remaining = numBlocks;
+
+  while (remaining > 0) {
+    uint16_t count = (remaining < maxBlocks) ? remaining : maxBlocks;
+    frame[12] = (uint8_t)blockNo;
+    frame[13] = (uint8_t)(count - 1);
+
+    PN5180DEBUG("Read Multiple Blocks #");
+    PN5180DEBUG(blockNo);
+    PN5180DEBUG(", count=");
+    PN5180DEBUG(count);
+    PN5180DEBUG("\n");
+
+    uint8_t *resultPtr;
+    uint16_t resultLen;
+    ISO15693ErrorCode rc = issueISO15693Frame(frame, 14, 0, 0, &resultPtr, &resultLen);
+    if (ISO15693_EC_OK != rc) {
+      return rc;
+    }
+
+    uint16_t len = count * blockSize;
+    if (resultLen < 1 + len) {
+      PN5180DEBUG(F("*** ERROR: Read Multiple Blocks response too short!\n"));
+      return ISO15693_EC_UNKNOWN_ERROR;
+    }
+    for (uint16_t i=0; i<len; i++) {
+      blockData[i] = resultPtr[1+i];
+    }
+
+    blockData += len;
+    blockNo += count;
+    remaining -= count;
+  }
+
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Write multiple blocks, code=24
+ *
+ * Request format: SOF, Requ.Flags, WriteMultipleBlock, UID (opt.), FirstBlockNumber, NumBlocks-1, BlockData (len=blockSize*numBlocks), CRC16, EOF
+ * Response format:
+ *  when ERROR flag is set:
+ *    SOF, Resp.Flags, ErrorCode, CRC16, EOF
+ *
+ *  when ERROR flag is NOT set:
+ *    SOF, Resp.Flags, CRC16, EOF
+ *
+ * The data is split into commands of max. PN5180_ISO15693_MAX_WRITE_SIZE bytes.
+ * Write Multiple Blocks is optional in ISO15693 (e.g. not supported by ICODE SLIX),
+ * if the tag does not support it, the blocks are written with writeSingleBlock().
+ */
+ISO15693ErrorCode PN5180ISO15693::writeMultipleBlocks(uint8_t *uid, uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize) {
+  if ((0 == blockSize) || (blockSize > PN5180_ISO15693_MAX_WRITE_SIZE) ||
+      (0 == numBlocks) || (firstBlock + numBlocks > 256)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  uint8_t writeCmd[12 + PN5180_ISO15693_MAX_WRITE_SIZE];
+  writeCmd[0] = 0x22; // high data rate, no options, addressed by UID
+  writeCmd[1] = 0x24;
+  for (int i=0; i<8; i++) {
+    writeCmd[2+i] = uid[i]; // UID has LSB first!
+  }
+
+  uint16_t maxBlocks = PN5180_ISO15693_MAX_WRITE_SIZE / blockSize;
+  uint16_t blockNo = firstBlock;
+  uint16_t remaining = numBlocks;
+  bool multipleSupported = true;
+
+  while (remaining > 0) {
+    ISO15693ErrorCode rc;
+    uint16_t count = 1;
+    if (multipleSupported) {
+      count = (remaining < maxBlocks) ? remaining : maxBlocks;
+      writeCmd[10] = (uint8_t)blockNo;
+      writeCmd[11] = (uint8_t)(count - 1);
+      uint16_t len = count * blockSize;
+      for (uint16_t i=0; i<len; i++) {
+        writeCmd[12+i] = blockData[i];
+      }
+
+      PN5180DEBUG("Write Multiple Blocks #");
+      PN5180DEBUG(blockNo);
+      PN5180DEBUG(", count=");
+      PN5180DEBUG(count);
+      PN5180DEBUG("\n");
+
+      uint8_t *resultPtr;
+      rc = issueISO15693Command(writeCmd, 12 + len, &resultPtr);
+      if ((ISO15693_EC_NOT_SUPPORTED == rc) || (ISO15693_EC_NOT_RECOGNIZED == rc)) {
+        PN5180DEBUG(F("Write Multiple Blocks not supported, using Write Single Block\n"));
+        multipleSupported = false;
+        continue;
+      }
+    }
+    else {
+      rc = writeSingleBlock(uid, (uint8_t)blockNo, blockData, blockSize);
+    }
+    if (ISO15693_EC_OK != rc) {
+      return rc;
+    }
+
+    blockData += count * blockSize;
+    blockNo += count;
+    remaining -= count;
   }
 
-  free(writeCmd);
   return ISO15693_EC_OK;
 }
 
@@ -274,11 +668,8 @@ ISO15693ErrorCode PN5180ISO15693::getSystemInfo(uint8_t *uid, uint8_t *blockSize
   }
 
 #ifdef DEBUG
-  PN5180DEBUG("Get System Information");
-  for (int i=0; i<sizeof(sysInfo); i++) {
-    PN5180DEBUG(" ");
-    PN5180DEBUG(formatHex(sysInfo[i]));
-  }
+  PN5180DEBUG("Get System Information ");
+  PN5180DEBUG_HEX(sysInfo, sizeof(sysInfo));
   PN5180DEBUG("\n");
 #endif
 
@@ -306,8 +697,9 @@ ISO15693ErrorCode PN5180ISO15693::getSystemInfo(uint8_t *uid, uint8_t *blockSize
   uint8_t infoFlags = readBuffer[1];
   if (infoFlags & 0x01) { // DSFID flag
     PN5180DEBUG("DSFID=");  // Data storage format identifier
-    PN5180DEBUG(formatHex(uint8_t(*p++)));
+    PN5180DEBUG(formatHex(uint8_t(*p)));
     PN5180DEBUG("\n");
+    p++;
   }
 #ifdef DEBUG
   else PN5180DEBUG(F("No DSFID\n"));  
@@ -362,8 +754,9 @@ ISO15693ErrorCode PN5180ISO15693::getSystemInfo(uint8_t *uid, uint8_t *blockSize
    
   if (infoFlags & 0x08) { // IC reference
     PN5180DEBUG("IC Ref=");
-    PN5180DEBUG(formatHex(uint8_t(*p++)));
+    PN5180DEBUG(formatHex(uint8_t(*p)));
     PN5180DEBUG("\n");
+    p++;
   }
 #ifdef DEBUG
   else PN5180DEBUG(F("No IC ref\n"));
@@ -503,24 +896,81 @@ ISO15693ErrorCode PN5180ISO15693::enablePrivacyMode(uint8_t *password) {
  *   -1 = No card detected
  *   >0 = Error code
  */
-ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr) {
+ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr, uint16_t *resultLen) {
+  PN5180STATS(PN5180StatsTimer timer(getHAL(), &stats.iso15693Command));
 #ifdef DEBUG
   PN5180DEBUG(F("Issue Command 0x"));
   PN5180DEBUG(formatHex(cmd[1]));
   PN5180DEBUG("...\n");
 #endif
 
-  sendData(cmd, cmdLen);
-  delay(10);
+  beginRegisterBatch();
+  clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | RX_SOF_DET_IRQ_STAT);
+  bool success = sendData(cmd, cmdLen);
+  if (!endRegisterBatch() || !success) {
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+
+  ISO15693ErrorCode rc = receiveISO15693Response(cmd[0], cmd[1], cmdLen, resultPtr, resultLen);
+  PN5180STATS(timer.success = (ISO15693_EC_OK == rc));
+  return rc;
+}
+
+/*
+ * Same as above for a frame prepared by PN5180ISO15693::Session, see
+ * sendDataFrame(): frame[0..1] are reserved, the request starts at frame[2]
+ * and data is appended without copying
+ */
+ISO15693ErrorCode PN5180ISO15693::issueISO15693Frame(uint8_t *frame, uint8_t frameLen, uint8_t *data, uint8_t dataLen, uint8_t **resultPtr, uint16_t *resultLen) {
+  PN5180STATS(PN5180StatsTimer timer(getHAL(), &stats.iso15693Command));
+#ifdef DEBUG
+  PN5180DEBUG(F("Issue Command 0x"));
+  PN5180DEBUG(formatHex(frame[3]));
+  PN5180DEBUG("...\n");
+#endif
 
-  uint32_t irqR = getIRQStatus();
-  if (0 == (irqR & RX_SOF_DET_IRQ_STAT)) {
-	return EC_NO_CARD;
+  beginRegisterBatch();
+  clearIRQStatus(RX_IRQ_STAT | TX_IRQ_STAT | IDLE_IRQ_STAT | RX_SOF_DET_IRQ_STAT);
+  bool success = sendDataFrame(frame, frameLen, data, dataLen);
+  if (!endRegisterBatch() || !success) {
+    return ISO15693_EC_UNKNOWN_ERROR;
   }
-  
-  while(!(irqR & RX_IRQ_STAT)) {
-	delay(1);
-	irqR = getIRQStatus();
+
+  ISO15693ErrorCode rc = receiveISO15693Response(frame[2], frame[3], frameLen - 2 + dataLen, resultPtr, resultLen);
+  PN5180STATS(timer.success = (ISO15693_EC_OK == rc));
+  return rc;
+}
+
+/*
+ * Waits for and reads the response of the request sent with the given
+ * request flags, command code and length
+ */
+ISO15693ErrorCode PN5180ISO15693::receiveISO15693Response(uint8_t flags, uint8_t command, uint16_t cmdLen, uint8_t **resultPtr, uint16_t *resultLen) {
+  // expected response window from command type and data rate
+  uint32_t sofTimeoutUs = PN5180ISO15693_SOF_TIMEOUT;
+  if ((0x21 == command) || (0x22 == command) || (0x24 == command) ||
+      ((command >= 0x27) && (command <= 0x2A)) || (command >= 0xA0)) {
+    // write/lock and custom commands, e.g. set password
+    sofTimeoutUs = PN5180ISO15693_WRITE_SOF_TIMEOUT;
+  }
+  // SOF, EOF and CRC are transmitted additionally
+  uint32_t txTimeoutUs = (uint32_t)(cmdLen + 4) * PN5180ISO15693_TX_BYTE_TIME;
+  uint32_t rxTimeoutUs = (uint32_t)(getReadBufferSize() + 4) * PN5180ISO15693_RX_BYTE_TIME;
+  if (0 == (flags & 0x02)) { // low data rate
+    txTimeoutUs *= 4;
+    sofTimeoutUs *= 4;
+    rxTimeoutUs *= 4;
+  }
+  txTimeoutUs += 1000; // start of transmission
+
+  uint32_t irqR = waitForResponse(txTimeoutUs, sofTimeoutUs, rxTimeoutUs);
+  if (0 == (irqR & RX_SOF_DET_IRQ_STAT)) { // no card answered in the SOF window
+    clearIRQStatus(TX_IRQ_STAT | IDLE_IRQ_STAT);
+    return EC_NO_CARD;
+  }
+  if (0 == (irqR & RX_IRQ_STAT)) {
+    PN5180DEBUG(F("*** ERROR: Timeout waiting for end of reception!\n"));
+    return ISO15693_EC_UNKNOWN_ERROR;
   }
   
   uint32_t rxStatus;
@@ -540,22 +990,14 @@ ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(uint8_t *cmd, uint8_t cmd
     PN5180DEBUG(F("*** ERROR in readData!\n"));
     return ISO15693_EC_UNKNOWN_ERROR;
   }
+  if (resultLen) *resultLen = len;
   
 #ifdef DEBUG
-  Serial.print("Read=");
-  for (int i=0; i<len; i++) {
-    Serial.print(formatHex((*resultPtr)[i]));
-    if (i<len-1) Serial.print(":");
-  }
-  Serial.println();
+  PN5180DEBUG(F("Read="));
+  PN5180DEBUG_HEX(*resultPtr, len);
+  PN5180DEBUG("\n");
 #endif
 
-  uint32_t irqStatus = getIRQStatus();
-  if (0 == (RX_SOF_DET_IRQ_STAT & irqStatus)) { // no card detected
-     clearIRQStatus(TX_IRQ_STAT | IDLE_IRQ_STAT);
-     return EC_NO_CARD;
-  }
-
   uint8_t responseFlags = (*resultPtr)[0];
   if (responseFlags & (1<<0)) { // error flag
     uint8_t errorCode = (*resultPtr)[1];
@@ -563,7 +1005,7 @@ ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(uint8_t *cmd, uint8_t cmd
     PN5180DEBUG("ERROR code=");
     PN5180DEBUG(formatHex(errorCode));
     PN5180DEBUG(" - ");
-    PN5180DEBUG(strerror(errorCode));
+    PN5180DEBUG(strerror((ISO15693ErrorCode)errorCode));
     PN5180DEBUG("\n");
 
     if (errorCode >= 0xA0) { // custom command error codes
@@ -582,6 +1024,104 @@ ISO15693ErrorCode PN5180ISO15693::issueISO15693Command(uint8_t *cmd, uint8_t cmd
   return ISO15693_EC_OK;
 }
 
+/*
+ * Request templates of PN5180ISO15693::Session, addressed by UID with high
+ * data rate. The first two bytes are the SEND_DATA header set by
+ * sendDataFrame(), the UID (bytes 4-11) is filled in by the constructor.
+ */
+//                                                        header,     flags, cmd, uid,             params
+static constexpr uint8_t readSingleBlockTemplate[]    = { 0x09, 0x00, 0x22, 0x20, 0,0,0,0,0,0,0,0, 0 };
+static constexpr uint8_t writeSingleBlockTemplate[]   = { 0x09, 0x00, 0x22, 0x21, 0,0,0,0,0,0,0,0, 0 };
+static constexpr uint8_t readMultipleBlocksTemplate[] = { 0x09, 0x00, 0x22, 0x23, 0,0,0,0,0,0,0,0, 0, 0 };
+static constexpr uint8_t systemInfoTemplate[]         = { 0x09, 0x00, 0x22, 0x2b, 0,0,0,0,0,0,0,0 };
+
+static void prepareSessionFrame(uint8_t *frame, const uint8_t *frameTemplate, uint8_t len, const uint8_t *uid) {
+  for (uint8_t i=0; i<len; i++) {
+    frame[i] = frameTemplate[i];
+  }
+  for (uint8_t i=0; i<8; i++) {
+    frame[4+i] = uid[i];
+  }
+}
+
+PN5180ISO15693::Session::Session(PN5180ISO15693 &reader, const uint8_t *uid) : reader(reader) {
+  static_assert(sizeof(readSingleBlockTemplate) == sizeof(readSingleFrame), "frame size");
+  static_assert(sizeof(writeSingleBlockTemplate) == sizeof(writeSingleFrame), "frame size");
+  static_assert(sizeof(readMultipleBlocksTemplate) == sizeof(readMultipleFrame), "frame size");
+  static_assert(sizeof(systemInfoTemplate) == sizeof(systemInfoFrame), "frame size");
+  prepareSessionFrame(readSingleFrame, readSingleBlockTemplate, sizeof(readSingleFrame), uid);
+  prepareSessionFrame(writeSingleFrame, writeSingleBlockTemplate, sizeof(writeSingleFrame), uid);
+  prepareSessionFrame(readMultipleFrame, readMultipleBlocksTemplate, sizeof(readMultipleFrame), uid);
+  prepareSessionFrame(systemInfoFrame, systemInfoTemplate, sizeof(systemInfoFrame), uid);
+}
+
+/*
+ * The UID bound to the session, LSB first
+ */
+const uint8_t *PN5180ISO15693::Session::getUid() {
+  return &readSingleFrame[4];
+}
+
+ISO15693ErrorCode PN5180ISO15693::Session::readSingleBlock(uint8_t blockNo, uint8_t *blockData, uint8_t blockSize) {
+  readSingleFrame[12] = blockNo;
+
+  uint8_t *resultPtr;
+  uint16_t resultLen;
+  ISO15693ErrorCode rc = reader.issueISO15693Frame(readSingleFrame, sizeof(readSingleFrame), 0, 0, &resultPtr, &resultLen);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
+  if (resultLen < 1 + blockSize) {
+    return ISO15693_EC_UNKNOWN_ERROR;
+  }
+  for (int i=0; i<blockSize; i++) {
+    blockData[i] = resultPtr[1+i];
+  }
+  return ISO15693_EC_OK;
+}
+
+/*
+ * The block data is appended to the request in the SPI frame, no copy
+ */
+ISO15693ErrorCode PN5180ISO15693::Session::writeSingleBlock(uint8_t blockNo, uint8_t *blockData, uint8_t blockSize) {
+  if ((0 == blockSize) || (blockSize > PN5180_ISO15693_MAX_BLOCK_SIZE)) {
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  }
+  writeSingleFrame[12] = blockNo;
+
+  uint8_t *resultPtr;
+  return reader.issueISO15693Frame(writeSingleFrame, sizeof(writeSingleFrame), blockData, blockSize, &resultPtr);
+}
+
+/*
+ * Split into several requests by the helper shared with readMultipleBlocks()
+ */
+ISO15693ErrorCode PN5180ISO15693::Session::readMultipleBlocks(uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize) {
+  return reader.readMultipleBlocksFrame(readMultipleFrame, firstBlock, numBlocks, blockData, blockSize);
+}
+
+/*
+ * Block size and number of blocks only, numBlocks is 0 for 256 blocks as
+ * with PN5180ISO15693::getSystemInfo()
+ */
+ISO15693ErrorCode PN5180ISO15693::Session::getSystemInfo(uint8_t *blockSize, uint8_t *numBlocks) {
+  uint8_t *resultPtr;
+  ISO15693ErrorCode rc = reader.issueISO15693Frame(systemInfoFrame, sizeof(systemInfoFrame), 0, 0, &resultPtr);
+  if (ISO15693_EC_OK != rc) {
+    return rc;
+  }
+  uint8_t infoFlags = resultPtr[1];
+  uint8_t *p = &resultPtr[10];
+  if (infoFlags & 0x01) p++; // DSFID
+  if (infoFlags & 0x02) p++; // AFI
+  if (0 == (infoFlags & 0x04)) { // no VICC memory size
+    return ISO15693_EC_NOT_SUPPORTED;
+  }
+  *numBlocks = p[0] + 1;
+  *blockSize = (p[1] & 0x1f) + 1;
+  return ISO15693_EC_OK;
+}
+
 bool PN5180ISO15693::setupRF() {
   PN5180DEBUG(F("Loading RF-Configuration...\n"));
   if (loadRFConfig(0x0d, 0x8d)) {  // ISO15693 parameters
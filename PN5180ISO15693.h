@@ -36,18 +36,56 @@ enum ISO15693ErrorCode {
   ISO15693_EC_CUSTOM_CMD_ERROR = 0xA0
 };
 
-class PN5180ISO15693 : public PN5180 {
+// max. number of collided slots remembered by getInventoryMultiple()
+#ifndef PN5180_ISO15693_MAX_COLLISIONS
+#define PN5180_ISO15693_MAX_COLLISIONS 16
+#endif
+
+// max. block size of the tags written with writeSingleBlock(), ISO15693 allows up to 32 bytes
+#ifndef PN5180_ISO15693_MAX_BLOCK_SIZE
+#define PN5180_ISO15693_MAX_BLOCK_SIZE 32
+#endif
+
+// max. number of data bytes sent with one Write Multiple Blocks command,
+// writeMultipleBlocks() uses a stack buffer of this size + 12 bytes
+#ifndef PN5180_ISO15693_MAX_WRITE_SIZE
+#define PN5180_ISO15693_MAX_WRITE_SIZE 64
+#endif
+#if PN5180_ISO15693_MAX_WRITE_SIZE > 243
+#error "PN5180_ISO15693_MAX_WRITE_SIZE must not exceed 243 bytes (255 byte command)"
+#endif
+
+// PN5180 is a virtual base, see PN5180ISO14443.h. Subclasses have to call a
+// PN5180 constructor in their own initializer list.
+class PN5180ISO15693 : public virtual PN5180 {
 
 public:
-  PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin);
+  PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, SPIClass& spi = SPI);
+  PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, SPIClass& spi = SPI);
+  PN5180ISO15693(uint8_t SSpin, uint8_t BUSYpin, uint8_t RSTpin, uint8_t IRQpin, PN5180HAL& hal);
   
 private:
-  ISO15693ErrorCode issueISO15693Command(uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr);
+  // tag tracked by checkPresence()
+  uint8_t trackedUid[8];
+  bool tracking;
+  PN5180CardRemovedCallback removedCallback;
+  void *removedCallbackArg;
+
+  ISO15693ErrorCode issueISO15693Command(uint8_t *cmd, uint8_t cmdLen, uint8_t **resultPtr, uint16_t *resultLen = 0);
+  ISO15693ErrorCode issueISO15693Frame(uint8_t *frame, uint8_t frameLen, uint8_t *data, uint8_t dataLen, uint8_t **resultPtr, uint16_t *resultLen = 0);
+  ISO15693ErrorCode readMultipleBlocksFrame(uint8_t *frame, uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode receiveISO15693Response(uint8_t flags, uint8_t command, uint16_t cmdLen, uint8_t **resultPtr, uint16_t *resultLen = 0);
+  uint32_t waitForResponse(uint32_t txTimeoutUs, uint32_t sofTimeoutUs, uint32_t rxTimeoutUs);
+  ISO15693ErrorCode inventoryRound(uint8_t maskLen, uint8_t *mask, uint8_t *uids, uint8_t maxTags, uint8_t *numTags,
+                                   uint8_t *collisionMasks, uint8_t *numCollisions);
 public:
   ISO15693ErrorCode getInventory(uint8_t *uid);
+  ISO15693ErrorCode getInventoryMultiple(uint8_t *uids, uint8_t maxTags, uint8_t *numTags);
 
   ISO15693ErrorCode readSingleBlock(uint8_t *uid, uint8_t blockNo, uint8_t *blockData, uint8_t blockSize);
   ISO15693ErrorCode writeSingleBlock(uint8_t *uid, uint8_t blockNo, uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode readMultipleBlocks(uint8_t *uid, uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize);
+  ISO15693ErrorCode writeMultipleBlocks(uint8_t *uid, uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize);
 
   ISO15693ErrorCode getSystemInfo(uint8_t *uid, uint8_t *blockSize, uint8_t *numBlocks);
    
@@ -63,8 +101,45 @@ public:
    */
 public:   
   bool setupRF();
+  bool isCardPresent();
   const __FlashStringHelper *strerror(ISO15693ErrorCode errno);
-    
+  /*
+   * Presence tracking of one tag, see checkPresence()
+   */
+public:
+  ISO15693ErrorCode startPresenceTracking(uint8_t *uid = 0, PN5180CardRemovedCallback onRemoved = 0, void *arg = 0);
+  bool checkPresence();
+  void stopPresenceTracking();
+  bool isPresenceTracking();
+
+  /*
+   * Addressed requests prepared for one tag. The UID is bound once in the
+   * constructor, each call only patches the block parameters of the
+   * prepared frame and sends it with sendDataFrame().
+   *
+   * Usage:
+   *   PN5180ISO15693::Session tag(nfc, uid);
+   *   tag.readSingleBlock(blockNo, blockData, blockSize);
+   */
+public:
+  class Session {
+  public:
+    Session(PN5180ISO15693 &reader, const uint8_t *uid);
+
+    const uint8_t *getUid();
+    ISO15693ErrorCode readSingleBlock(uint8_t blockNo, uint8_t *blockData, uint8_t blockSize);
+    ISO15693ErrorCode writeSingleBlock(uint8_t blockNo, uint8_t *blockData, uint8_t blockSize);
+    ISO15693ErrorCode readMultipleBlocks(uint8_t firstBlock, uint16_t numBlocks, uint8_t *blockData, uint8_t blockSize);
+    ISO15693ErrorCode getSystemInfo(uint8_t *blockSize, uint8_t *numBlocks);
+
+  private:
+    PN5180ISO15693 &reader;
+    // SEND_DATA header (2 bytes), flags, command, UID (LSB first), parameters
+    uint8_t readSingleFrame[13];
+    uint8_t writeSingleFrame[13];
+    uint8_t readMultipleFrame[14];
+    uint8_t systemInfoFrame[12];
+  };
 };
 
 #endif /* PN5180ISO15693_H */
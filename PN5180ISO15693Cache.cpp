@@ -0,0 +1,220 @@
+// NAME: PN5180ISO15693Cache.cpp
+//
+// DESC: Block cache with write-back for one ISO15693 tag.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180ISO15693Cache.h"
+#include "Debug.h"
+
+PN5180ISO15693Cache::PN5180ISO15693Cache(PN5180ISO15693 &reader, const uint8_t *uid, uint8_t *storage, uint16_t storageSize)
+                   : reader(reader) {
+  for (int i=0; i<8; i++) this->uid[i] = uid[i];
+  this->storage = storage;
+  this->storageSize = storageSize;
+  blockSize = 0;
+  numBlocks = 0;
+  cachedBlocks = 0;
+  invalidate();
+}
+
+/*
+ * Reads block size and number of blocks with one Get System Information
+ */
+ISO15693ErrorCode PN5180ISO15693Cache::begin() {
+  // not set if the tag does not report its memory size
+  uint8_t sysBlockSize = 0, sysNumBlocks = 0;
+  invalidate();
+  ISO15693ErrorCode rc = reader.getSystemInfo(uid, &sysBlockSize, &sysNumBlocks);
+  if (ISO15693_EC_OK != rc)
+    return rc;
+  if ((0 == sysBlockSize) || (sysBlockSize > PN5180_ISO15693_MAX_BLOCK_SIZE))
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+  blockSize = sysBlockSize;
+  // 256 blocks are reported as 0
+  numBlocks = (0 == sysNumBlocks) ? 256 : sysNumBlocks;
+  cachedBlocks = storageSize / blockSize;
+  if (cachedBlocks > numBlocks) cachedBlocks = numBlocks;
+
+  PN5180DEBUG(F("Cache: "));
+  PN5180DEBUG(cachedBlocks);
+  PN5180DEBUG(F(" of "));
+  PN5180DEBUG(numBlocks);
+  PN5180DEBUG(F(" blocks cached\n"));
+  return ISO15693_EC_OK;
+}
+
+uint8_t PN5180ISO15693Cache::getBlockSize() {
+  return blockSize;
+}
+
+uint16_t PN5180ISO15693Cache::getNumBlocks() {
+  return numBlocks;
+}
+
+uint16_t PN5180ISO15693Cache::getCachedBlocks() {
+  return cachedBlocks;
+}
+
+bool PN5180ISO15693Cache::testBit(const uint8_t *bits, uint16_t n) {
+  return (0 != (bits[n >> 3] & (1 << (n & 7))));
+}
+
+void PN5180ISO15693Cache::setBit(uint8_t *bits, uint16_t n, bool value) {
+  if (value) bits[n >> 3] |= (1 << (n & 7));
+  else bits[n >> 3] &= ~(1 << (n & 7));
+}
+
+/*
+ * Reads the blocks not yet in the cache, one Read Multiple Blocks for each
+ * run of missing blocks
+ */
+ISO15693ErrorCode PN5180ISO15693Cache::fetch(uint16_t firstBlock, uint16_t count) {
+  uint16_t block = firstBlock;
+  uint16_t end = firstBlock + count;
+  while (block < end) {
+    if (testBit(valid, block)) {
+      block++;
+      continue;
+    }
+    uint16_t runEnd = block + 1;
+    while ((runEnd < end) && !testBit(valid, runEnd)) runEnd++;
+
+    ISO15693ErrorCode rc = reader.readMultipleBlocks(uid, (uint8_t)block, runEnd - block,
+                                                     storage + block * blockSize, blockSize);
+    if (ISO15693_EC_OK != rc)
+      return rc;
+    for (uint16_t i = block; i < runEnd; i++) setBit(valid, i, true);
+    block = runEnd;
+  }
+  return ISO15693_EC_OK;
+}
+
+ISO15693ErrorCode PN5180ISO15693Cache::readBlock(uint8_t blockNo, uint8_t *blockData) {
+  return readBlocks(blockNo, 1, blockData);
+}
+
+/*
+ * blockData : count * blockSize bytes
+ */
+ISO15693ErrorCode PN5180ISO15693Cache::readBlocks(uint8_t firstBlock, uint16_t count, uint8_t *blockData) {
+  if ((0 == blockSize) || (0 == count) || (firstBlock + count > numBlocks))
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+
+  // cached part
+  uint16_t cachedCount = 0;
+  if (firstBlock < cachedBlocks) {
+    cachedCount = cachedBlocks - firstBlock;
+    if (cachedCount > count) cachedCount = count;
+    ISO15693ErrorCode rc = fetch(firstBlock, cachedCount);
+    if (ISO15693_EC_OK != rc)
+      return rc;
+    uint16_t len = cachedCount * blockSize;
+    const uint8_t *p = storage + firstBlock * blockSize;
+    for (uint16_t i = 0; i < len; i++) blockData[i] = p[i];
+  }
+  // blocks beyond the buffer
+  if (cachedCount < count) {
+    return reader.readMultipleBlocks(uid, (uint8_t)(firstBlock + cachedCount), count - cachedCount,
+                                     blockData + cachedCount * blockSize, blockSize);
+  }
+  return ISO15693_EC_OK;
+}
+
+ISO15693ErrorCode PN5180ISO15693Cache::writeBlock(uint8_t blockNo, const uint8_t *blockData) {
+  return writeBlocks(blockNo, 1, blockData);
+}
+
+/*
+ * Changes the cached blocks, blocks with unchanged content are not marked
+ * dirty. Blocks beyond the buffer are written immediately.
+ */
+ISO15693ErrorCode PN5180ISO15693Cache::writeBlocks(uint8_t firstBlock, uint16_t count, const uint8_t *blockData) {
+  if ((0 == blockSize) || (0 == count) || (firstBlock + count > numBlocks))
+    return ISO15693_EC_BLOCK_NOT_AVAILABLE;
+
+  uint16_t block = firstBlock;
+  uint16_t end = firstBlock + count;
+  for (; (block < end) && (block < cachedBlocks); block++) {
+    uint8_t *p = storage + block * blockSize;
+    bool changed = !testBit(valid, block);
+    for (uint8_t i = 0; i < blockSize; i++) {
+      if (p[i] != blockData[i]) {
+        p[i] = blockData[i];
+        changed = true;
+      }
+    }
+    setBit(valid, block, true);
+    if (changed) setBit(dirty, block, true);
+    blockData += blockSize;
+  }
+  if (block < end) {
+    return reader.writeMultipleBlocks(uid, (uint8_t)block, end - block, (uint8_t *)blockData, blockSize);
+  }
+  return ISO15693_EC_OK;
+}
+
+/*
+ * Writes the dirty blocks, consecutive blocks with one Write Multiple Blocks
+ * (Write Single Block if the tag does not support it). The blocks written
+ * successfully are clean afterwards, the first error is returned.
+ */
+ISO15693ErrorCode PN5180ISO15693Cache::flush() {
+  uint16_t block = 0;
+  while (block < cachedBlocks) {
+    if (!testBit(dirty, block)) {
+      block++;
+      continue;
+    }
+    uint16_t runEnd = block + 1;
+    while ((runEnd < cachedBlocks) && testBit(dirty, runEnd)) runEnd++;
+
+    uint8_t *p = storage + block * blockSize;
+    ISO15693ErrorCode rc;
+    if (1 == runEnd - block)
+      rc = reader.writeSingleBlock(uid, (uint8_t)block, p, blockSize);
+    else
+      rc = reader.writeMultipleBlocks(uid, (uint8_t)block, runEnd - block, p, blockSize);
+    if (ISO15693_EC_OK != rc) {
+      PN5180DEBUG(F("Cache: flush of block "));
+      PN5180DEBUG(block);
+      PN5180DEBUG(F(" failed: "));
+      PN5180DEBUG(reader.strerror(rc));
+      PN5180DEBUG("\n");
+      return rc;
+    }
+    for (uint16_t i = block; i < runEnd; i++) setBit(dirty, i, false);
+    block = runEnd;
+  }
+  return ISO15693_EC_OK;
+}
+
+bool PN5180ISO15693Cache::isDirty() {
+  for (uint8_t i = 0; i < sizeof(dirty); i++) {
+    if (dirty[i]) return true;
+  }
+  return false;
+}
+
+/*
+ * Discards the cached blocks including unwritten changes
+ */
+void PN5180ISO15693Cache::invalidate() {
+  for (uint8_t i = 0; i < sizeof(valid); i++) {
+    valid[i] = 0;
+    dirty[i] = 0;
+  }
+}
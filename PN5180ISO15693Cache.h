@@ -0,0 +1,71 @@
+// NAME: PN5180ISO15693Cache.h
+//
+// DESC: Block cache with write-back for one ISO15693 tag.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180ISO15693CACHE_H
+#define PN5180ISO15693CACHE_H
+
+#include "PN5180ISO15693.h"
+
+/*
+ * Caches the blocks of the tag with the given UID in a buffer of the caller.
+ * Reads are served from the buffer after the first access, writes only
+ * change the buffer and mark the blocks dirty. flush() writes the dirty
+ * blocks with one WRITE MULTIPLE BLOCKS per run of consecutive blocks.
+ * Blocks beyond the buffer size are read and written directly.
+ *
+ * Usage:
+ *   uint8_t memory[256];
+ *   PN5180ISO15693Cache cache(nfc, uid, memory, sizeof(memory));
+ *   cache.begin();
+ *   cache.readBlock(0, data); ... cache.writeBlock(1, data); ...
+ *   cache.flush();
+ */
+class PN5180ISO15693Cache {
+public:
+  PN5180ISO15693Cache(PN5180ISO15693 &reader, const uint8_t *uid, uint8_t *storage, uint16_t storageSize);
+
+  ISO15693ErrorCode begin();
+  uint8_t getBlockSize();
+  uint16_t getNumBlocks();
+  uint16_t getCachedBlocks();
+
+  ISO15693ErrorCode readBlock(uint8_t blockNo, uint8_t *blockData);
+  ISO15693ErrorCode readBlocks(uint8_t firstBlock, uint16_t count, uint8_t *blockData);
+  ISO15693ErrorCode writeBlock(uint8_t blockNo, const uint8_t *blockData);
+  ISO15693ErrorCode writeBlocks(uint8_t firstBlock, uint16_t count, const uint8_t *blockData);
+
+  ISO15693ErrorCode flush();
+  bool isDirty();
+  void invalidate();
+
+private:
+  PN5180ISO15693 &reader;
+  uint8_t uid[8];
+  uint8_t *storage;
+  uint16_t storageSize;
+  uint8_t blockSize;
+  uint16_t numBlocks;
+  uint16_t cachedBlocks;
+  // one bit per block
+  uint8_t valid[32];
+  uint8_t dirty[32];
+
+  static bool testBit(const uint8_t *bits, uint16_t n);
+  static void setBit(uint8_t *bits, uint16_t n, bool value);
+  ISO15693ErrorCode fetch(uint16_t firstBlock, uint16_t count);
+};
+
+#endif /* PN5180ISO15693CACHE_H */
@@ -0,0 +1,479 @@
+// NAME: PN5180NDEF.cpp
+//
+// DESC: NDEF message reading and writing on NFC Forum Type 2 (NTAG/Ultralight)
+//       and Type 5 (ISO15693) tags.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180NDEF.h"
+#include "Debug.h"
+
+// TLV tags of the data area
+#define NDEF_TLV_NULL        0x00
+#define NDEF_TLV_NDEF        0x03
+#define NDEF_TLV_TERMINATOR  0xFE
+
+/*
+ * Type 2 tag
+ */
+PN5180NDEFType2Tag::PN5180NDEFType2Tag(PN5180ISO14443 &reader) : reader(reader) {
+  fastRead = true;
+}
+
+/*
+ * Reads whole pages into the page buffer and copies the requested bytes.
+ * If FAST_READ is answered with a NAK (MIFARE Ultralight), the tag is
+ * activated again with WUPA and read with READ from then on.
+ */
+bool PN5180NDEFType2Tag::readBytes(uint16_t offset, uint8_t *buffer, uint16_t len) {
+  while (len > 0) {
+    uint16_t page = offset / 4;
+    uint8_t skip = offset % 4;
+    uint16_t chunk = PN5180_NDEF_CHUNK_SIZE - skip;
+    if (chunk > len) chunk = len;
+    uint8_t numPages = (skip + chunk + 3) / 4;
+    if (page + numPages > 256)
+      return false;
+
+    bool success = false;
+    if (fastRead) {
+      success = reader.ntagFastRead(page, page + numPages - 1, pages);
+      if (!success) {
+        PN5180DEBUG(F("NDEF: FAST_READ not supported, using READ\n"));
+        fastRead = false;
+        if (0 == reader.activateTypeA(pages, 1))
+          return false;
+      }
+    }
+    if (!success) {
+      // READ returns 4 pages
+      for (uint8_t i = 0; i < numPages; i += 4) {
+        if (!reader.mifareBlockRead(page + i, pages + 4*i))
+          return false;
+      }
+    }
+
+    for (uint16_t i = 0; i < chunk; i++) buffer[i] = pages[skip + i];
+    buffer += chunk;
+    offset += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+/*
+ * Writes page by page, the other bytes of partially written pages are read first
+ */
+bool PN5180NDEFType2Tag::writeBytes(uint16_t offset, const uint8_t *buffer, uint16_t len) {
+  uint8_t data[4];
+  while (len > 0) {
+    uint16_t page = offset / 4;
+    uint8_t skip = offset % 4;
+    uint8_t chunk = 4 - skip;
+    if (chunk > len) chunk = len;
+    if (page > 255)
+      return false;
+
+    if (chunk < 4) {
+      if (!readBytes(page * 4, data, 4))
+        return false;
+    }
+    for (uint8_t i = 0; i < chunk; i++) data[skip + i] = buffer[i];
+    if (0x0A != (reader.ntagWrite(page, data) & 0x0F)) {
+      PN5180DEBUG(F("NDEF: write of page "));
+      PN5180DEBUG(page);
+      PN5180DEBUG(F(" failed\n"));
+      return false;
+    }
+    buffer += chunk;
+    offset += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+/*
+ * CC in page 3: magic number E1, version, data area size / 8, access conditions,
+ * the data area starts at page 4
+ */
+bool PN5180NDEFType2Tag::readCapabilityContainer(uint16_t *dataStart, uint16_t *dataSize, bool *readOnly) {
+  uint8_t cc[4];
+  if (!readBytes(12, cc, 4))
+    return false;
+  if (0xE1 != cc[0])
+    return false;
+  *dataStart = 16;
+  *dataSize = 8 * cc[2];
+  *readOnly = (0x00 != (cc[3] & 0x0F));
+  return true;
+}
+
+/*
+ * Type 5 tag
+ */
+PN5180NDEFType5Tag::PN5180NDEFType5Tag(PN5180ISO15693 &reader, const uint8_t *uid) : reader(reader) {
+  for (uint8_t i = 0; i < 8; i++) this->uid[i] = uid[i];
+  blockSize = 0;
+  numBlocks = 0;
+  multiBlockRead = false;
+}
+
+bool PN5180NDEFType5Tag::readBytes(uint16_t offset, uint8_t *buffer, uint16_t len) {
+  if (0 == blockSize)
+    return false;
+  uint8_t blocksPerChunk = PN5180_NDEF_CHUNK_SIZE / blockSize;
+  while (len > 0) {
+    uint16_t block = offset / blockSize;
+    uint8_t skip = offset % blockSize;
+    uint16_t chunk = blocksPerChunk * blockSize - skip;
+    if (chunk > len) chunk = len;
+    uint8_t count = (skip + chunk + blockSize - 1) / blockSize;
+    if (block + count > numBlocks)
+      return false;
+
+    if (multiBlockRead) {
+      if (ISO15693_EC_OK != reader.readMultipleBlocks(uid, block, count, blocks, blockSize))
+        return false;
+    }
+    else {
+      for (uint8_t i = 0; i < count; i++) {
+        if (ISO15693_EC_OK != reader.readSingleBlock(uid, block + i, blocks + i * blockSize, blockSize))
+          return false;
+      }
+    }
+    for (uint16_t i = 0; i < chunk; i++) buffer[i] = blocks[skip + i];
+    buffer += chunk;
+    offset += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+/*
+ * Whole blocks are written with WRITE MULTIPLE BLOCKS directly from the
+ * buffer, the first/last block is read first if written partially
+ */
+bool PN5180NDEFType5Tag::writeBytes(uint16_t offset, const uint8_t *buffer, uint16_t len) {
+  if (0 == blockSize)
+    return false;
+  while (len > 0) {
+    uint16_t block = offset / blockSize;
+    uint8_t skip = offset % blockSize;
+    ISO15693ErrorCode rc;
+    uint16_t chunk;
+    if ((0 == skip) && (len >= blockSize)) {
+      uint16_t count = len / blockSize;
+      if (block + count > numBlocks)
+        return false;
+      chunk = count * blockSize;
+      rc = reader.writeMultipleBlocks(uid, block, count, (uint8_t *)buffer, blockSize);
+    }
+    else {
+      chunk = blockSize - skip;
+      if (chunk > len) chunk = len;
+      if (block >= numBlocks)
+        return false;
+      rc = reader.readSingleBlock(uid, block, blocks, blockSize);
+      if (ISO15693_EC_OK != rc)
+        return false;
+      for (uint16_t i = 0; i < chunk; i++) blocks[skip + i] = buffer[i];
+      rc = reader.writeSingleBlock(uid, block, blocks, blockSize);
+    }
+    if (ISO15693_EC_OK != rc) {
+      PN5180DEBUG(F("NDEF: write of block "));
+      PN5180DEBUG(block);
+      PN5180DEBUG(F(" failed: "));
+      PN5180DEBUG(reader.strerror(rc));
+      PN5180DEBUG("\n");
+      return false;
+    }
+    buffer += chunk;
+    offset += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+/*
+ * CC in the first bytes of block 0: magic number E1/E2, version and access,
+ * data area size / 8, features. If the size byte is 0, the CC has 8 bytes
+ * and the size is in bytes 6..7.
+ */
+bool PN5180NDEFType5Tag::readCapabilityContainer(uint16_t *dataStart, uint16_t *dataSize, bool *readOnly) {
+  // not set if the tag does not report its memory size
+  uint8_t sysBlockSize = 0, sysNumBlocks = 0;
+  multiBlockRead = false;
+  ISO15693ErrorCode rc = reader.getSystemInfo(uid, &sysBlockSize, &sysNumBlocks);
+  if (ISO15693_EC_OK != rc)
+    return false;
+  if ((0 == sysBlockSize) || (sysBlockSize > PN5180_ISO15693_MAX_BLOCK_SIZE))
+    return false;
+  blockSize = sysBlockSize;
+  // 256 blocks are reported as 0
+  numBlocks = (0 == sysNumBlocks) ? 256 : sysNumBlocks;
+
+  uint8_t cc[8];
+  if (!readBytes(0, cc, 4))
+    return false;
+  if ((0xE1 != cc[0]) && (0xE2 != cc[0]))
+    return false;
+  if (0 != cc[2]) {
+    *dataStart = 4;
+    *dataSize = 8 * cc[2];
+  }
+  else {
+    if (!readBytes(4, cc + 4, 4))
+      return false;
+    *dataStart = 8;
+    *dataSize = 8 * (((uint16_t)cc[6] << 8) | cc[7]);
+  }
+  // the data area ends with the tag memory at the latest
+  uint16_t memorySize = blockSize * numBlocks;
+  if (*dataStart >= memorySize)
+    *dataSize = 0;
+  else if (*dataSize > memorySize - *dataStart)
+    *dataSize = memorySize - *dataStart;
+  *readOnly = (0x00 != (cc[1] & 0x03));
+  // MBREAD: the tag supports READ MULTIPLE BLOCKS
+  multiBlockRead = (0 != (cc[3] & 0x01));
+  return true;
+}
+
+/*
+ * NDEF message
+ */
+PN5180NDEF::PN5180NDEF(PN5180NDEFTag &tag) : tag(tag) {
+  dataStart = 0;
+  dataSize = 0;
+  readOnly = true;
+  messageOffset = 0;
+  messageLength = 0;
+  bufferOffset = 0;
+  bufferLength = 0;
+}
+
+/*
+ * Reads the tag bytes from offset into the read buffer, but not beyond end
+ */
+bool PN5180NDEF::fill(uint16_t offset, uint16_t end) {
+  uint16_t len = end - offset;
+  if (len > PN5180_NDEF_CHUNK_SIZE) len = PN5180_NDEF_CHUNK_SIZE;
+  bufferLength = 0;
+  if (!tag.readBytes(offset, buffer, len))
+    return false;
+  bufferOffset = offset;
+  bufferLength = len;
+  return true;
+}
+
+bool PN5180NDEF::readByte(uint16_t offset, uint16_t end, uint8_t *value) {
+  if (offset >= end)
+    return false;
+  if ((offset < bufferOffset) || (offset >= bufferOffset + bufferLength)) {
+    if (!fill(offset, end))
+      return false;
+  }
+  *value = buffer[offset - bufferOffset];
+  return true;
+}
+
+/*
+ * Reads the capability container and searches the NDEF message TLV,
+ * the TLVs are read chunk by chunk up to the NDEF message.
+ * return value: false if the tag is not NDEF formatted, on read errors
+ * and TLVs beyond the data area
+ */
+bool PN5180NDEF::begin() {
+  messageLength = 0;
+  bufferLength = 0;
+  if (!tag.readCapabilityContainer(&dataStart, &dataSize, &readOnly))
+    return false;
+
+  uint16_t end = dataStart + dataSize;
+  uint16_t pos = dataStart;
+  uint8_t t, l;
+  while (pos < end) {
+    if (!readByte(pos, end, &t))
+      return false;
+    if (NDEF_TLV_TERMINATOR == t)
+      break;
+    if (NDEF_TLV_NULL == t) {
+      pos++;
+      continue;
+    }
+    // 1 byte length, or FF and 2 bytes length
+    uint16_t len;
+    if (!readByte(pos + 1, end, &l))
+      return false;
+    pos += 2;
+    len = l;
+    if (0xFF == l) {
+      uint8_t hi, lo;
+      if (!readByte(pos, end, &hi) || !readByte(pos + 1, end, &lo))
+        return false;
+      pos += 2;
+      len = ((uint16_t)hi << 8) | lo;
+    }
+    if (NDEF_TLV_NDEF == t) {
+      if (len > end - pos)
+        return false;
+      messageOffset = pos;
+      messageLength = len;
+      PN5180DEBUG(F("NDEF message: "));
+      PN5180DEBUG(len);
+      PN5180DEBUG(F(" bytes\n"));
+      return true;
+    }
+    // lock/memory control or proprietary TLV
+    if (len > end - pos)
+      return false;
+    pos += len;
+  }
+  // no NDEF message TLV, the message is written to the start of the data area
+  messageOffset = dataStart + 2;
+  return true;
+}
+
+uint16_t PN5180NDEF::getMessageLength() {
+  return messageLength;
+}
+
+/*
+ * The TLV at the start of the data area needs 2 or 4 bytes and the terminator TLV 1 byte
+ */
+uint16_t PN5180NDEF::getMaxMessageLength() {
+  if (dataSize < 4)
+    return 0;
+  if (dataSize - 3 < 0xFF)
+    return dataSize - 3;
+  return (dataSize - 5 < 0xFF) ? 0xFE : dataSize - 5;
+}
+
+bool PN5180NDEF::isReadOnly() {
+  return readOnly;
+}
+
+/*
+ * Streams the records of the message found by begin() to the callback.
+ * Payloads are passed in parts of up to PN5180_NDEF_CHUNK_SIZE bytes
+ * directly from the read buffer.
+ */
+bool PN5180NDEF::readMessage(PN5180NDEFRecordCallback callback, void *arg) {
+  uint16_t end = messageOffset + messageLength;
+  uint16_t pos = messageOffset;
+  PN5180NDEFRecord record;
+  uint8_t b;
+
+  while (pos < end) {
+    if (!readByte(pos++, end, &record.header) || !readByte(pos++, end, &record.typeLength))
+      return false;
+    record.payloadLength = 0;
+    uint8_t numLengthBytes = (record.header & NDEF_FLAG_SR) ? 1 : 4;
+    for (uint8_t i = 0; i < numLengthBytes; i++) {
+      if (!readByte(pos++, end, &b))
+        return false;
+      record.payloadLength = (record.payloadLength << 8) | b;
+    }
+    record.idLength = 0;
+    if ((record.header & NDEF_FLAG_IL) && !readByte(pos++, end, &record.idLength))
+      return false;
+    for (uint16_t i = 0; i < record.typeLength; i++) {
+      if (!readByte(pos++, end, &b))
+        return false;
+      if (i < PN5180_NDEF_MAX_TYPE_LENGTH) record.type[i] = b;
+    }
+    for (uint16_t i = 0; i < record.idLength; i++) {
+      if (!readByte(pos++, end, &b))
+        return false;
+      if (i < PN5180_NDEF_MAX_ID_LENGTH) record.id[i] = b;
+    }
+    if (record.payloadLength > (uint32_t)(end - pos))
+      return false;
+
+    uint32_t offset = 0;
+    do {
+      uint16_t len = record.payloadLength - offset;
+      if (len > 0) {
+        if ((pos < bufferOffset) || (pos >= bufferOffset + bufferLength)) {
+          if (!fill(pos, end))
+            return false;
+        }
+        uint16_t available = bufferOffset + bufferLength - pos;
+        if (len > available) len = available;
+      }
+      if (!callback(&record, buffer + (pos - bufferOffset), offset, len, arg))
+        return true;
+      pos += len;
+      offset += len;
+    } while (offset < record.payloadLength);
+
+    if (record.header & NDEF_FLAG_ME)
+      break;
+  }
+  return true;
+}
+
+/*
+ * Copies the message found by begin() into message, size bytes at most
+ */
+bool PN5180NDEF::readMessage(uint8_t *message, uint16_t size, uint16_t *len) {
+  *len = messageLength;
+  if (messageLength > size)
+    return false;
+  return tag.readBytes(messageOffset, message, messageLength);
+}
+
+/*
+ * Writes the message as NDEF message TLV to the start of the data area.
+ * The TLV is written with length 0 first and its length is set after the
+ * message, so an interrupted write leaves an empty message on the tag.
+ */
+bool PN5180NDEF::writeMessage(const uint8_t *message, uint16_t len) {
+  if (readOnly || (0 == dataSize) || (len > getMaxMessageLength()))
+    return false;
+
+  uint8_t tlv[4];
+  uint8_t tlvLength = (len < 0xFF) ? 2 : 4;
+  tlv[0] = NDEF_TLV_NDEF;
+  tlv[1] = 0x00;
+  tlv[2] = 0x00;
+  tlv[3] = 0x00;
+  if (4 == tlvLength) tlv[1] = 0xFF;
+  if (!tag.writeBytes(dataStart, tlv, tlvLength))
+    return false;
+
+  uint16_t pos = dataStart + tlvLength;
+  if (!tag.writeBytes(pos, message, len))
+    return false;
+  uint8_t terminator = NDEF_TLV_TERMINATOR;
+  if (!tag.writeBytes(pos + len, &terminator, 1))
+    return false;
+
+  if (4 == tlvLength) {
+    tlv[2] = (uint8_t)(len >> 8);
+    tlv[3] = (uint8_t)len;
+  }
+  else {
+    tlv[1] = (uint8_t)len;
+  }
+  if (!tag.writeBytes(dataStart, tlv, tlvLength))
+    return false;
+
+  messageOffset = pos;
+  messageLength = len;
+  bufferLength = 0;
+  return true;
+}
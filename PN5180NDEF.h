@@ -0,0 +1,158 @@
+// NAME: PN5180NDEF.h
+//
+// DESC: NDEF message reading and writing on NFC Forum Type 2 (NTAG/Ultralight)
+//       and Type 5 (ISO15693) tags.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180NDEF_H
+#define PN5180NDEF_H
+
+#include "PN5180ISO14443.h"
+#include "PN5180ISO15693.h"
+
+// size of the read buffers, the tag is read in chunks of this size
+#ifndef PN5180_NDEF_CHUNK_SIZE
+#define PN5180_NDEF_CHUNK_SIZE 64
+#endif
+#if (PN5180_NDEF_CHUNK_SIZE < 2*PN5180_ISO15693_MAX_BLOCK_SIZE) || (PN5180_NDEF_CHUNK_SIZE % 16)
+#error "PN5180_NDEF_CHUNK_SIZE must be a multiple of 16 and hold 2 ISO15693 blocks"
+#endif
+// longer record types/IDs are truncated in PN5180NDEFRecord
+#ifndef PN5180_NDEF_MAX_TYPE_LENGTH
+#define PN5180_NDEF_MAX_TYPE_LENGTH 32
+#endif
+#ifndef PN5180_NDEF_MAX_ID_LENGTH
+#define PN5180_NDEF_MAX_ID_LENGTH 16
+#endif
+
+// TNF and header flags of NDEF records
+#define NDEF_TNF_EMPTY         0x00
+#define NDEF_TNF_WELL_KNOWN    0x01
+#define NDEF_TNF_MIME_MEDIA    0x02
+#define NDEF_TNF_ABSOLUTE_URI  0x03
+#define NDEF_TNF_EXTERNAL_TYPE 0x04
+#define NDEF_TNF_UNKNOWN       0x05
+#define NDEF_TNF_UNCHANGED     0x06
+#define NDEF_TNF_MASK          0x07
+#define NDEF_FLAG_IL           (1<<3)
+#define NDEF_FLAG_SR           (1<<4)
+#define NDEF_FLAG_CF           (1<<5)
+#define NDEF_FLAG_ME           (1<<6)
+#define NDEF_FLAG_MB           (1<<7)
+
+/*
+ * Memory access of one tag type, offsets are byte addresses in the tag memory
+ * (Type 2: 4 * page, Type 5: blockSize * block)
+ */
+class PN5180NDEFTag {
+public:
+  virtual bool readBytes(uint16_t offset, uint8_t *buffer, uint16_t len) = 0;
+  virtual bool writeBytes(uint16_t offset, const uint8_t *buffer, uint16_t len) = 0;
+  // reads the capability container: start and size of the data area
+  virtual bool readCapabilityContainer(uint16_t *dataStart, uint16_t *dataSize, bool *readOnly) = 0;
+};
+
+/*
+ * NFC Forum Type 2 tag, NTAG21x and MIFARE Ultralight. The tag has to be
+ * activated with activateTypeA(). Reads with FAST_READ, or READ if the tag
+ * does not know FAST_READ, writes with WRITE (4 bytes per page).
+ */
+class PN5180NDEFType2Tag : public PN5180NDEFTag {
+public:
+  PN5180NDEFType2Tag(PN5180ISO14443 &reader);
+
+  virtual bool readBytes(uint16_t offset, uint8_t *buffer, uint16_t len);
+  virtual bool writeBytes(uint16_t offset, const uint8_t *buffer, uint16_t len);
+  virtual bool readCapabilityContainer(uint16_t *dataStart, uint16_t *dataSize, bool *readOnly);
+
+private:
+  PN5180ISO14443 &reader;
+  bool fastRead;
+  uint8_t pages[PN5180_NDEF_CHUNK_SIZE];
+};
+
+/*
+ * NFC Forum Type 5 tag (ISO15693) with the given UID. Reads with
+ * READ MULTIPLE BLOCKS if the CC has the MBREAD bit set, otherwise with
+ * READ SINGLE BLOCK. Partially written blocks are read first.
+ */
+class PN5180NDEFType5Tag : public PN5180NDEFTag {
+public:
+  PN5180NDEFType5Tag(PN5180ISO15693 &reader, const uint8_t *uid);
+
+  virtual bool readBytes(uint16_t offset, uint8_t *buffer, uint16_t len);
+  virtual bool writeBytes(uint16_t offset, const uint8_t *buffer, uint16_t len);
+  virtual bool readCapabilityContainer(uint16_t *dataStart, uint16_t *dataSize, bool *readOnly);
+
+private:
+  PN5180ISO15693 &reader;
+  uint8_t uid[8];
+  uint8_t blockSize;
+  uint16_t numBlocks;
+  bool multiBlockRead;   // MBREAD bit of the CC
+  uint8_t blocks[PN5180_NDEF_CHUNK_SIZE];
+};
+
+struct PN5180NDEFRecord {
+  uint8_t header;        // MB, ME, CF, SR, IL flags and TNF
+  uint8_t typeLength;    // length on the tag, max. PN5180_NDEF_MAX_TYPE_LENGTH bytes are in type
+  uint8_t idLength;      // length on the tag, max. PN5180_NDEF_MAX_ID_LENGTH bytes are in id
+  uint32_t payloadLength;
+  uint8_t type[PN5180_NDEF_MAX_TYPE_LENGTH];
+  uint8_t id[PN5180_NDEF_MAX_ID_LENGTH];
+};
+
+/*
+ * Called for each part of a record payload, offset is the position of data
+ * in the payload. Records with an empty payload are reported once with len = 0.
+ * Return false to stop reading the message.
+ */
+typedef bool (*PN5180NDEFRecordCallback)(const PN5180NDEFRecord *record,
+                                         const uint8_t *data, uint32_t offset, uint16_t len, void *arg);
+
+/*
+ * NDEF message of a tag. begin() reads the capability container and finds
+ * the NDEF message TLV, readMessage() streams the records to a callback
+ * and reads only the blocks covering the message.
+ */
+class PN5180NDEF {
+public:
+  PN5180NDEF(PN5180NDEFTag &tag);
+
+  bool begin();
+  uint16_t getMessageLength();
+  uint16_t getMaxMessageLength();
+  bool isReadOnly();
+
+  bool readMessage(PN5180NDEFRecordCallback callback, void *arg = 0);
+  bool readMessage(uint8_t *message, uint16_t size, uint16_t *len);
+  bool writeMessage(const uint8_t *message, uint16_t len);
+
+private:
+  PN5180NDEFTag &tag;
+  uint16_t dataStart;
+  uint16_t dataSize;
+  bool readOnly;
+  uint16_t messageOffset;  // offset of the NDEF message
+  uint16_t messageLength;
+
+  // read buffer, holds the tag bytes bufferOffset..bufferOffset+bufferLength-1
+  uint8_t buffer[PN5180_NDEF_CHUNK_SIZE];
+  uint16_t bufferOffset;
+  uint16_t bufferLength;
+  bool fill(uint16_t offset, uint16_t end);
+  bool readByte(uint16_t offset, uint16_t end, uint8_t *value);
+};
+
+#endif /* PN5180NDEF_H */
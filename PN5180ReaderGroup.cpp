@@ -0,0 +1,126 @@
+// NAME: PN5180ReaderGroup.cpp
+//
+// DESC: Implementation of PN5180ReaderGroup class.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+//#define DEBUG 1
+
+#include <Arduino.h>
+#include "PN5180ReaderGroup.h"
+#include "Debug.h"
+
+PN5180ReaderGroup::PN5180ReaderGroup() {
+  numReaders = 0;
+  nextReader = 0;
+}
+
+bool PN5180ReaderGroup::addReader(PN5180 *reader) {
+  if (numReaders >= PN5180_MAX_READERS) {
+    PN5180DEBUG(F("*** ERROR: Too many readers in group!\n"));
+    return false;
+  }
+  readers[numReaders] = reader;
+  hasQueued[numReaders] = false;
+  hasFailed[numReaders] = false;
+  numReaders++;
+  return true;
+}
+
+/*
+ * Submit an exchange for reader 'index'. It is started at once, if the
+ * reader is idle, otherwise it is queued and started by poll() as soon as
+ * the current exchange has finished. Returns false, if the reader already
+ * has a queued exchange or an unreported failure. An exchange which cannot
+ * be started is reported to onComplete by the next poll().
+ */
+bool PN5180ReaderGroup::submit(uint8_t index, uint8_t *data, int len, uint8_t validBits,
+                               uint8_t *rxBuffer, uint16_t rxBufferSize, uint32_t timeoutUs,
+                               PN5180TransceiveCallback onComplete, void *arg) {
+  if (index >= numReaders || hasQueued[index] || hasFailed[index]) {
+    return false;
+  }
+
+  Job &job = queued[index];
+  job.data = data;
+  job.len = len;
+  job.validBits = validBits;
+  job.rxBuffer = rxBuffer;
+  job.rxBufferSize = rxBufferSize;
+  job.timeoutUs = timeoutUs;
+  job.onComplete = onComplete;
+  job.arg = arg;
+
+  PN5180 *reader = readers[index];
+  if (!reader->isTransceiveActive() && !reader->isBusy()) {
+    start(index, job);
+    return true;
+  }
+  hasQueued[index] = true;
+  return true;
+}
+
+bool PN5180ReaderGroup::start(uint8_t index, Job &job) {
+  bool success = readers[index]->startTransceive(job.data, job.len, job.validBits,
+                                                 job.rxBuffer, job.rxBufferSize, job.timeoutUs,
+                                                 job.onComplete, job.arg);
+  if (!success) {
+    // not called from here, the callback could submit again recursively
+    failed[index] = job;
+    hasFailed[index] = true;
+  }
+  return success;
+}
+
+/*
+ * Service all readers of the group once, round robin. Readers with BUSY
+ * asserted are skipped. Completion callbacks are called from here.
+ * Returns the number of readers with an active or queued exchange.
+ */
+uint8_t PN5180ReaderGroup::poll() {
+  uint8_t pending = 0;
+  for (uint8_t n=0; n<numReaders; n++) {
+    uint8_t i = (nextReader + n) % numReaders;
+    PN5180 *reader = readers[i];
+
+    if (hasFailed[i]) {
+      // the callback may submit to this reader again
+      Job job = failed[i];
+      hasFailed[i] = false;
+      if (job.onComplete) {
+        job.onComplete(reader, false, job.rxBuffer, 0, job.arg);
+      }
+    }
+    if (reader->isBusy()) {
+      if (reader->isTransceiveActive() || hasQueued[i] || hasFailed[i]) pending++;
+      continue;
+    }
+    if (reader->isTransceiveActive()) {
+      reader->poll();
+    }
+    if (!reader->isTransceiveActive() && hasQueued[i]) {
+      hasQueued[i] = false;
+      start(i, queued[i]);
+    }
+    if (reader->isTransceiveActive() || hasQueued[i] || hasFailed[i]) pending++;
+  }
+  if (numReaders > 0) nextReader = (nextReader + 1) % numReaders;
+  return pending;
+}
+
+bool PN5180ReaderGroup::isIdle() {
+  for (uint8_t i=0; i<numReaders; i++) {
+    if (readers[i]->isTransceiveActive() || hasQueued[i] || hasFailed[i]) return false;
+  }
+  return true;
+}
@@ -0,0 +1,72 @@
+// NAME: PN5180ReaderGroup.h
+//
+// DESC: Scheduler for several PN5180 modules sharing one SPI bus.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180READERGROUP_H
+#define PN5180READERGROUP_H
+
+#include "PN5180.h"
+
+// max. number of readers in one group
+#define PN5180_MAX_READERS  8
+
+/*
+ * A reader group drives the non-blocking transceive of several PN5180
+ * modules. While the RF exchange of one reader is in flight, the SPI bus
+ * is used to start or finish the exchanges of the other readers. Readers
+ * signalling BUSY are skipped instead of blocking the bus.
+ * Each reader has room for one queued exchange besides the active one.
+ * Callbacks are only called from poll(), so they may submit the next
+ * exchange of their reader.
+ */
+class PN5180ReaderGroup {
+private:
+  struct Job {
+    uint8_t *data;
+    int len;
+    uint8_t validBits;
+    uint8_t *rxBuffer;
+    uint16_t rxBufferSize;
+    uint32_t timeoutUs;
+    PN5180TransceiveCallback onComplete;
+    void *arg;
+  };
+
+  PN5180 *readers[PN5180_MAX_READERS];
+  Job queued[PN5180_MAX_READERS];
+  bool hasQueued[PN5180_MAX_READERS];
+  // exchange which could not be started, reported by poll()
+  Job failed[PN5180_MAX_READERS];
+  bool hasFailed[PN5180_MAX_READERS];
+  uint8_t numReaders;
+  uint8_t nextReader;
+
+  bool start(uint8_t index, Job &job);
+
+public:
+  PN5180ReaderGroup();
+
+  bool addReader(PN5180 *reader);
+  uint8_t size() { return numReaders; }
+  PN5180 *getReader(uint8_t index) { return (index < numReaders) ? readers[index] : 0; }
+
+  bool submit(uint8_t index, uint8_t *data, int len, uint8_t validBits,
+              uint8_t *rxBuffer, uint16_t rxBufferSize, uint32_t timeoutUs,
+              PN5180TransceiveCallback onComplete, void *arg = 0);
+  uint8_t poll();
+  bool isIdle();
+};
+
+#endif /* PN5180READERGROUP_H */
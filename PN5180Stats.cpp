@@ -0,0 +1,39 @@
+// NAME: PN5180Stats.cpp
+//
+// DESC: Timing and traffic statistics of the PN5180 host interface and RF commands.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <Arduino.h>
+#include "PN5180Stats.h"
+
+#ifdef PN5180_STATS
+
+PN5180StatsTimer::PN5180StatsTimer(PN5180HAL *hal, PN5180TimingStats *stats) {
+  this->hal = hal;
+  this->stats = stats;
+  success = false;
+  startUs = hal->getMicros();
+}
+
+PN5180StatsTimer::~PN5180StatsTimer() {
+  if (0 == stats) return;
+  uint32_t us = hal->getMicros() - startUs;
+  if ((0 == stats->count) || (us < stats->minUs)) stats->minUs = us;
+  if (us > stats->maxUs) stats->maxUs = us;
+  stats->count++;
+  stats->totalUs += us;
+  if (!success) stats->failed++;
+}
+
+#endif
@@ -0,0 +1,73 @@
+// NAME: PN5180Stats.h
+//
+// DESC: Timing and traffic statistics of the PN5180 host interface and RF commands.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180STATS_H
+#define PN5180STATS_H
+
+#include <Arduino.h>
+#include "PN5180HAL.h"
+
+/*
+ * The statistics are collected if PN5180_STATS is defined as build flag
+ * (-DPN5180_STATS), it has to be defined for all files of the library.
+ * Without it, PN5180STATS(..) compiles to nothing and getStats() returns false.
+ */
+#ifdef PN5180_STATS
+#define PN5180STATS(...) __VA_ARGS__
+#else
+#define PN5180STATS(...)
+#endif
+
+// host interface commands 0x00..0x19
+#define PN5180_STATS_COMMANDS 0x1A
+
+struct PN5180TimingStats {
+  uint32_t count;
+  uint32_t failed;   // timeouts of the BUSY line or RF errors
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint32_t avgUs;    // filled by getStats()
+  uint32_t totalUs;
+};
+
+struct PN5180Stats {
+  PN5180TimingStats command[PN5180_STATS_COMMANDS]; // by opcode of transceiveCommand
+  uint32_t busyWaitUs;       // time waiting for the BUSY line
+  uint32_t busyTimeouts;
+  uint32_t spiBytesSent;
+  uint32_t spiBytesReceived;
+  PN5180TimingStats iso15693Command; // issueISO15693Command, failed = no card or error code
+  PN5180TimingStats activateTypeA;   // failed = no card
+};
+
+#ifdef PN5180_STATS
+/*
+ * Measures the time from its construction to the end of the enclosing
+ * block, counted as failed unless success was set.
+ */
+class PN5180StatsTimer {
+public:
+  PN5180StatsTimer(PN5180HAL *hal, PN5180TimingStats *stats);
+  ~PN5180StatsTimer();
+  bool success;
+private:
+  PN5180HAL *hal;
+  PN5180TimingStats *stats;
+  unsigned long startUs;
+};
+#endif
+
+#endif /* PN5180STATS_H */
@@ -0,0 +1,178 @@
+// NAME: PN5180Trace.cpp
+//
+// DESC: Ring buffer recording the SPI frames of all PN5180 instances.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <Arduino.h>
+#include "PN5180Trace.h"
+#include "Debug.h"
+
+#ifdef PN5180_TRACE
+
+// frame header: type, id, length (2 bytes), stored length, timestamp in us (4 bytes)
+#define TRACE_HEADER_SIZE 9
+
+static uint8_t traceRing[PN5180_TRACE_SIZE];
+static uint16_t traceHead = 0; // next byte to write
+static uint16_t traceTail = 0; // oldest frame
+static uint16_t traceUsed = 0;
+static uint32_t traceDropped = 0;
+
+/*
+ * The ring is shared by all tasks and cores (ESP32) or with ISRs. The
+ * other platforms restore the interrupt state of the caller, so record()
+ * can be called with interrupts disabled.
+ */
+#if defined(ARDUINO_ARCH_ESP32)
+static portMUX_TYPE traceLock = portMUX_INITIALIZER_UNLOCKED;
+#define TRACE_LOCK()   portENTER_CRITICAL(&traceLock)
+#define TRACE_UNLOCK() portEXIT_CRITICAL(&traceLock)
+#elif defined(__AVR__)
+#define TRACE_LOCK()   uint8_t traceSavedState = SREG; cli()
+#define TRACE_UNLOCK() SREG = traceSavedState
+#elif defined(ARDUINO_ARCH_ESP8266)
+#define TRACE_LOCK()   uint32_t traceSavedState = xt_rsil(15)
+#define TRACE_UNLOCK() xt_wsr_ps(traceSavedState)
+#elif defined(__arm__)
+#define TRACE_LOCK()   uint32_t traceSavedState; \
+                       __asm__ volatile ("mrs %0, primask\n cpsid i" : "=r" (traceSavedState) :: "memory")
+#define TRACE_UNLOCK() __asm__ volatile ("msr primask, %0" :: "r" (traceSavedState) : "memory")
+#else
+#define TRACE_LOCK()   noInterrupts()
+#define TRACE_UNLOCK() interrupts()
+#endif
+
+static inline void tracePut(uint8_t b) {
+  traceRing[traceHead] = b;
+  if (++traceHead >= PN5180_TRACE_SIZE) traceHead = 0;
+}
+
+static inline uint8_t tracePeek(uint16_t offset) {
+  uint16_t i = traceTail + offset;
+  if (i >= PN5180_TRACE_SIZE) i -= PN5180_TRACE_SIZE;
+  return traceRing[i];
+}
+
+static void traceRemoveOldest() {
+  uint16_t size = TRACE_HEADER_SIZE + tracePeek(4);
+  traceTail += size;
+  if (traceTail >= PN5180_TRACE_SIZE) traceTail -= PN5180_TRACE_SIZE;
+  traceUsed -= size;
+}
+
+/*
+ * Called on the hot path: copies the frame (data followed by data2) into
+ * the ring, no formatting
+ */
+void PN5180Trace::record(uint8_t type, uint8_t id, const uint8_t *data, uint16_t len,
+                         const uint8_t *data2, uint16_t len2) {
+  uint32_t timestamp = micros();
+  uint16_t total = len + len2;
+  uint8_t stored = (total > PN5180_TRACE_MAX_FRAME) ? PN5180_TRACE_MAX_FRAME : total;
+  uint16_t size = TRACE_HEADER_SIZE + stored;
+
+  TRACE_LOCK();
+  while (PN5180_TRACE_SIZE - traceUsed < size) {
+    traceRemoveOldest();
+    traceDropped++;
+  }
+  tracePut(type);
+  tracePut(id);
+  tracePut((uint8_t)total);
+  tracePut((uint8_t)(total >> 8));
+  tracePut(stored);
+  for (uint8_t i = 0; i < 4; i++) {
+    tracePut((uint8_t)timestamp);
+    timestamp >>= 8;
+  }
+  for (uint16_t i = 0; i < stored; i++) {
+    tracePut((i < len) ? data[i] : data2[i - len]);
+  }
+  traceUsed += size;
+  TRACE_UNLOCK();
+}
+
+/*
+ * Formats and prints the oldest frames, one line each:
+ *   <timestamp>us #<id> SPI> 07 00 08 (len=3)
+ * Each frame is copied out under the lock, printing is done without it.
+ * return value: number of frames printed
+ */
+uint16_t PN5180Trace::drain(Print &out, uint16_t maxFrames) {
+  uint8_t frame[TRACE_HEADER_SIZE + PN5180_TRACE_MAX_FRAME];
+  char line[3 * PN5180_TRACE_MAX_FRAME + 1];
+  uint16_t count = 0;
+
+  while (count < maxFrames) {
+    TRACE_LOCK();
+    if (0 == traceUsed) {
+      TRACE_UNLOCK();
+      break;
+    }
+    uint16_t size = TRACE_HEADER_SIZE + tracePeek(4);
+    for (uint16_t i = 0; i < size; i++) frame[i] = tracePeek(i);
+    traceRemoveOldest();
+    TRACE_UNLOCK();
+
+    uint16_t total = frame[2] | ((uint16_t)frame[3] << 8);
+    uint32_t timestamp = (uint32_t)frame[5] | ((uint32_t)frame[6] << 8) |
+                         ((uint32_t)frame[7] << 16) | ((uint32_t)frame[8] << 24);
+    out.print((unsigned long)timestamp);
+    out.print(F("us #"));
+    out.print(frame[1]);
+    out.print((PN5180_TRACE_SPI_SEND == frame[0]) ? F(" SPI> ") : F(" SPI< "));
+    out.print(formatHexDump(frame + TRACE_HEADER_SIZE, frame[4], line, sizeof(line)));
+    if (total > frame[4]) out.print(F(" .."));
+    out.print(F(" (len="));
+    out.print(total);
+    out.println(F(")"));
+    count++;
+  }
+  return count;
+}
+
+void PN5180Trace::clear() {
+  TRACE_LOCK();
+  traceHead = 0;
+  traceTail = 0;
+  traceUsed = 0;
+  traceDropped = 0;
+  TRACE_UNLOCK();
+}
+
+/*
+ * Number of frames dropped because the ring was full
+ */
+uint32_t PN5180Trace::getDropped() {
+  return traceDropped;
+}
+
+#else
+
+void PN5180Trace::record(uint8_t, uint8_t, const uint8_t *, uint16_t,
+                         const uint8_t *, uint16_t) {
+}
+
+uint16_t PN5180Trace::drain(Print &, uint16_t) {
+  return 0;
+}
+
+void PN5180Trace::clear() {
+}
+
+uint32_t PN5180Trace::getDropped() {
+  return 0;
+}
+
+#endif
@@ -0,0 +1,59 @@
+// NAME: PN5180Trace.h
+//
+// DESC: Ring buffer recording the SPI frames of all PN5180 instances.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef PN5180TRACE_H
+#define PN5180TRACE_H
+
+#include <Arduino.h>
+
+/*
+ * With the build flag PN5180_TRACE, transceiveCommand records each SPI
+ * frame in binary with a timestamp, formatting is done by drain() only.
+ * When the ring is full, the oldest frames are dropped. Without the flag
+ * PN5180TRACE(..) compiles to nothing and drain() prints nothing.
+ */
+#ifdef PN5180_TRACE
+#define PN5180TRACE(...) PN5180Trace::record(__VA_ARGS__)
+#else
+#define PN5180TRACE(...)
+#endif
+
+// size of the ring buffer in bytes, each frame needs 9 bytes + its data
+#ifndef PN5180_TRACE_SIZE
+#define PN5180_TRACE_SIZE 512
+#endif
+// frames are cut off after this number of bytes
+#ifndef PN5180_TRACE_MAX_FRAME
+#define PN5180_TRACE_MAX_FRAME 32
+#endif
+#if (PN5180_TRACE_MAX_FRAME > 255) || (PN5180_TRACE_SIZE < 9 + PN5180_TRACE_MAX_FRAME)
+#error "PN5180_TRACE_MAX_FRAME must be < 256 and fit into PN5180_TRACE_SIZE"
+#endif
+
+#define PN5180_TRACE_SPI_SEND    (0x01)
+#define PN5180_TRACE_SPI_RECEIVE (0x02)
+
+class PN5180Trace {
+public:
+  // id identifies the reader, PN5180 uses its NSS pin
+  static void record(uint8_t type, uint8_t id, const uint8_t *data, uint16_t len,
+                     const uint8_t *data2 = 0, uint16_t len2 = 0);
+  static uint16_t drain(Print &out, uint16_t maxFrames = 0xffff);
+  static void clear();
+  static uint32_t getDropped();
+};
+
+#endif /* PN5180TRACE_H */
@@ -0,0 +1,98 @@
+// NAME: PN5180-AdaptivePolling.ino
+//
+// DESC: Example usage of PN5180AdaptivePoller: fast polling while a tag is
+//       present, backoff with RF field off when idle and LPCD after a
+//       number of empty polls.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <PN5180.h>
+#include <PN5180Discovery.h>
+#include <PN5180AdaptivePoller.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+#define PN5180_IRQ  6
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+#define PN5180_IRQ  4
+
+#else
+#error Please define your pinout here!
+#endif
+
+PN5180Discovery nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST, PN5180_IRQ);
+PN5180AdaptivePoller poller(nfc);
+PN5180PollerState lastState = PN5180_POLLER_IDLE;
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 Adaptive Polling Demo Sketch"));
+
+  nfc.begin();
+
+  Serial.println(F("----------------------------------"));
+  Serial.println(F("PN5180 Hard-Reset..."));
+  if (!nfc.reset()) {
+    Serial.println(F("Initialization failed!?"));
+    Serial.println(F("Press reset to restart..."));
+    Serial.flush();
+    exit(-1); // halt
+  }
+
+  // LPCD reference measured with no card in the field
+  nfc.calibrateLPCD();
+  nfc.prepareLPCD();
+
+  poller.minInterval = 50;
+  poller.maxInterval = 1000;
+  poller.lpcdAfter = 10;
+  poller.begin();
+}
+
+void loop() {
+  uint8_t uid[10];
+  uint8_t uidLength;
+  PN5180Technology technology = poller.poll(uid, &uidLength);
+
+  if (PN5180_TECH_NONE != technology) {
+    Serial.print((PN5180_TECH_ISO14443A == technology) ? F("ISO-14443 UID=") : F("ISO-15693 UID="));
+    for (int i=0; i<uidLength; i++) {
+      // ISO15693: LSB is first
+      uint8_t b = (PN5180_TECH_ISO15693 == technology) ? uid[uidLength-1-i] : uid[i];
+      Serial.print(b < 0x10 ? " 0" : " ");
+      Serial.print(b, HEX);
+    }
+    Serial.println();
+  }
+
+  PN5180PollerState state = poller.getState();
+  if (state != lastState) {
+    static const char * const names[] = { "active", "idle", "LPCD", "cooldown" };
+    Serial.print(F("Poller state: "));
+    Serial.print(names[state]);
+    Serial.print(F(", RF duty cycle: "));
+    Serial.print(poller.getDutyCycle());
+    Serial.println(F(" per mille"));
+    lastState = state;
+  }
+}
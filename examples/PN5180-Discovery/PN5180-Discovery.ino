@@ -0,0 +1,93 @@
+// NAME: PN5180-Discovery.ino
+//
+// DESC: Example usage of PN5180Discovery: detect ISO14443A and ISO15693
+//       tags with one PN5180 instance, the RF field stays on and only the
+//       RF configuration is switched between the technologies.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <PN5180.h>
+#include <PN5180Discovery.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16   
+#define PN5180_BUSY 5  
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+PN5180Discovery nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 Discovery Demo Sketch"));
+
+  nfc.begin();
+
+  Serial.println(F("----------------------------------"));
+  Serial.println(F("PN5180 Hard-Reset..."));
+  if (!nfc.reset()) {
+    Serial.println(F("Initialization failed!?"));
+    Serial.println(F("Press reset to restart..."));
+    Serial.flush();
+    exit(-1); // halt
+  }
+
+  Serial.println(F("----------------------------------"));
+  Serial.println(F("Enable RF field..."));
+  nfc.setupRF();
+}
+
+void loop() {
+  uint8_t uid[10];
+  uint8_t uidLength;
+  unsigned long startTime = millis();
+  PN5180Technology technology = nfc.discover(uid, &uidLength);
+  unsigned long elapsedTime = millis() - startTime;
+
+  if (PN5180_TECH_ISO14443A == technology) {
+    Serial.print(F("ISO-14443 card found, UID="));
+    for (int i=0; i<uidLength; i++) {
+      Serial.print(uid[i] < 0x10 ? " 0" : " ");
+      Serial.print(uid[i], HEX);
+    }
+    Serial.println();
+  }
+  else if (PN5180_TECH_ISO15693 == technology) {
+    Serial.print(F("ISO-15693 card found, UID="));
+    for (int i=0; i<8; i++) {
+      Serial.print(uid[7-i] < 0x10 ? " 0" : " ");
+      Serial.print(uid[7-i], HEX); // LSB is first
+    }
+    Serial.println();
+  }
+  else {
+    Serial.println(F("*** No card detected!"));
+  }
+  Serial.print(F("polling cycle: "));
+  Serial.print(elapsedTime);
+  Serial.println(F(" mSec."));
+
+  delay(1000);
+}
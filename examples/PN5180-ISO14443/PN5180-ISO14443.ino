@@ -172,16 +172,17 @@ void loop() {
     Serial.print(F("no card found"));
     return;
   }
-  uint8_t uid[8];
-  if (!nfc.readCardSerial(uid)) {
+  uint8_t uid[10];
+  uint8_t uidLength = nfc.readCardSerial(uid, sizeof(uid));
+  if (!uidLength) {
     Serial.print(F("Error in readCardSerial: "));
     errorFlag = true;
     return;
   }
   Serial.print(F("card serial successful, UID="));
-  for (int i=0; i<8; i++) {
+  for (int i=0; i<uidLength; i++) {
     Serial.print(uid[i], HEX); 
-    if (i < 2) Serial.print(":");
+    if (i < uidLength-1) Serial.print(":");
   }
   Serial.println();
 
@@ -86,9 +86,21 @@ void setup() {
   Serial.print(F("irqPin="));
   Serial.println(irqPin[0]); //should read 1 i.e. pin IRQ is high(bolean 1/3.3v) when active(interrupted)  
 
-  if (nfc.prepareLPCD()) {
+  // adapt the LPCD threshold to the environment on power-up (no card in the field),
+  // after a wake-up by LPCD a card may be present, so keep the configuration
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_EXT1) {
+    if (nfc.calibrateLPCD()) {
+      Serial.print("calibrateLPCD success, reference=");
+      Serial.print(nfc.getLPCDReference());
+      Serial.print(", threshold=");
+      Serial.println(nfc.getLPCDThreshold());
+    }
+  }
+  else if (nfc.prepareLPCD()) {
     Serial.println("prepareLPCD success");
   }
+  Serial.print("LPCD average current [uA]: ");
+  Serial.println(PN5180::lpcdAverageCurrent(0xF0, wakeupCounterInMs));
   Serial.print("gpio4:"); Serial.println(digitalRead(PN5180_IRQ));
 
   // turn on LPCD
@@ -114,8 +126,10 @@ void setup() {
 void loop() {
   if (digitalRead(PN5180_IRQ) == HIGH) {
     showIRQStatus(nfc.getIRQStatus());
-    uint32_t registerValue;
-    nfc.readRegister(0x26, &registerValue);  Serial.print(registerValue); 
+    int16_t agcDelta;
+    if (nfc.getLPCDAGCDelta(&agcDelta)) {
+      Serial.print("AGC delta: "); Serial.println(agcDelta);
+    }
     delay(2000);
     nfc.reset(); //very important to have for lpcd to work
 	
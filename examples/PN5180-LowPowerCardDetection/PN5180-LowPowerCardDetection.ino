@@ -257,7 +257,7 @@ void loop() {
     uint8_t uid[10];
     nfc.setupRF();
     if (nfc.isCardPresent()) {
-      uint8_t uidLength = nfc.readCardSerial(uid);
+      uint8_t uidLength = nfc.readCardSerial(uid, sizeof(uid));
       if (uidLength > 0) {
         Serial.print(F("ISO14443 card found, UID="));
         for (int i=0; i<uidLength; i++) {
@@ -0,0 +1,79 @@
+// NAME: PN5180-MultiReader.ino
+//
+// DESC: Example usage of PN5180ReaderGroup: ISO15693 inventory on several
+//       PN5180 modules sharing one SPI bus. While one reader waits for the
+//       tag's answer, the bus is used to serve the other readers.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <PN5180.h>
+#include <PN5180ISO15693.h>
+#include <PN5180ReaderGroup.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+// all modules on VSPI (SCLK 18, MISO 19, MOSI 23), NSS/BUSY/RST per module
+PN5180ISO15693 nfc0(16, 5, 17, SPI);
+PN5180ISO15693 nfc1(21, 22, 17, SPI);
+PN5180ISO15693 nfc2(25, 26, 17, SPI);
+PN5180ISO15693 nfc3(32, 33, 17, SPI);
+
+#else
+#error Please define your pinout here!
+#endif
+
+PN5180ISO15693 *nfc[] = { &nfc0, &nfc1, &nfc2, &nfc3 };
+const uint8_t numReaders = sizeof(nfc) / sizeof(nfc[0]);
+
+PN5180ReaderGroup group;
+
+//                          Flags,  CMD, maskLen
+uint8_t inventory[] = { 0x26, 0x01, 0x00 };
+uint8_t response[numReaders][16];
+
+void onInventory(PN5180 *reader, bool success, uint8_t *data, uint16_t len, void *arg) {
+  uint8_t index = (uint8_t)(uintptr_t)arg;
+  if (success && len >= 10 && 0 == (data[0] & 0x01)) {
+    Serial.print(F("Reader #"));
+    Serial.print(index);
+    Serial.print(F(": UID="));
+    for (int i=0; i<8; i++) {
+      Serial.print(data[9-i], HEX); // LSB is first
+      if (i < 2) Serial.print(":");
+    }
+    Serial.println();
+  }
+  // start the next inventory of this reader right away
+  group.submit(index, inventory, sizeof(inventory), 0, response[index], sizeof(response[index]),
+               20000, onInventory, arg);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("PN5180 Multi-Reader Demo Sketch"));
+
+  for (uint8_t i=0; i<numReaders; i++) {
+    nfc[i]->begin();
+    nfc[i]->reset();
+    nfc[i]->setupRF();
+    group.addReader(nfc[i]);
+  }
+  for (uint8_t i=0; i<numReaders; i++) {
+    group.submit(i, inventory, sizeof(inventory), 0, response[i], sizeof(response[i]),
+                 20000, onInventory, (void *)(uintptr_t)i);
+  }
+}
+
+void loop() {
+  group.poll();
+}
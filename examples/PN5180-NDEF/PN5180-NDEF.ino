@@ -0,0 +1,114 @@
+// NAME: PN5180-NDEF.ino
+//
+// DESC: Example usage of PN5180NDEF: prints the NDEF records of NTAG/Ultralight
+//       (Type 2) and ISO15693 (Type 5) tags. The payloads are streamed from
+//       the tag in chunks, the tag is never read completely.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <PN5180.h>
+#include <PN5180Discovery.h>
+#include <PN5180NDEF.h>
+
+#if defined(ARDUINO_AVR_UNO) || defined(ARDUINO_AVR_MEGA2560) || defined(ARDUINO_AVR_NANO)
+
+#define PN5180_NSS  10
+#define PN5180_BUSY 9
+#define PN5180_RST  7
+
+#elif defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16   
+#define PN5180_BUSY 5  
+#define PN5180_RST  17
+
+#else
+#error Please define your pinout here!
+#endif
+
+PN5180Discovery nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST);
+
+bool printRecord(const PN5180NDEFRecord *record, const uint8_t *data, uint32_t offset, uint16_t len, void *arg) {
+  if (0 == offset) {
+    Serial.print(F("Record TNF="));
+    Serial.print(record->header & NDEF_TNF_MASK);
+    Serial.print(F(", type="));
+    for (int i=0; (i<record->typeLength) && (i<PN5180_NDEF_MAX_TYPE_LENGTH); i++) {
+      Serial.write(record->type[i]);
+    }
+    Serial.print(F(", payload length="));
+    Serial.println((unsigned long)record->payloadLength);
+  }
+  for (int i=0; i<len; i++) {
+    Serial.write((data[i] >= 0x20 && data[i] < 0x7f) ? data[i] : '.');
+  }
+  if (offset + len == record->payloadLength) {
+    Serial.println();
+  }
+  return true;
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 NDEF Demo Sketch"));
+
+  nfc.begin();
+
+  Serial.println(F("----------------------------------"));
+  Serial.println(F("PN5180 Hard-Reset..."));
+  if (!nfc.reset()) {
+    Serial.println(F("Initialization failed!?"));
+    Serial.println(F("Press reset to restart..."));
+    Serial.flush();
+    exit(-1); // halt
+  }
+
+  Serial.println(F("----------------------------------"));
+  Serial.println(F("Enable RF field..."));
+  nfc.setupRF();
+}
+
+void readNDEF(PN5180NDEFTag &tag) {
+  PN5180NDEF ndef(tag);
+  if (!ndef.begin()) {
+    Serial.println(F("Tag is not NDEF formatted"));
+    return;
+  }
+  Serial.print(F("NDEF message: "));
+  Serial.print(ndef.getMessageLength());
+  Serial.print(F(" of max. "));
+  Serial.print(ndef.getMaxMessageLength());
+  Serial.println(ndef.isReadOnly() ? F(" bytes, read only") : F(" bytes"));
+  if (!ndef.readMessage(printRecord)) {
+    Serial.println(F("*** Error reading the NDEF message"));
+  }
+}
+
+void loop() {
+  uint8_t uid[10];
+  uint8_t uidLength;
+  PN5180Technology technology = nfc.discover(uid, &uidLength);
+
+  if (PN5180_TECH_ISO14443A == technology) {
+    PN5180NDEFType2Tag tag(nfc);
+    readNDEF(tag);
+  }
+  else if (PN5180_TECH_ISO15693 == technology) {
+    PN5180NDEFType5Tag tag(nfc, uid);
+    readNDEF(tag);
+  }
+
+  delay(1000);
+}
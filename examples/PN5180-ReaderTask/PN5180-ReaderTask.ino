@@ -0,0 +1,79 @@
+// NAME: PN5180-ReaderTask.ino
+//
+// DESC: Example usage of PN5180ReaderTask on ESP32: a FreeRTOS task polls
+//       for tags and posts arrival/removal events to a queue, the SPI bus
+//       mutex can be shared with other devices on the same bus.
+//       Build the library with -DPN5180_FREERTOS, so the reader task
+//       sleeps while waiting for the PN5180.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#include <PN5180.h>
+#include <PN5180Discovery.h>
+#include <PN5180FreeRTOS.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+
+#define PN5180_NSS  16
+#define PN5180_BUSY 5
+#define PN5180_RST  17
+#define PN5180_IRQ  4
+
+#else
+#error This example needs an ESP32!
+#endif
+
+PN5180FreeRTOSHAL hal(SPI);
+PN5180Discovery nfc(PN5180_NSS, PN5180_BUSY, PN5180_RST, PN5180_IRQ, hal);
+PN5180ReaderTask readerTask(nfc);
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println(F("=================================="));
+  Serial.println(F("Uploaded: " __DATE__ " " __TIME__));
+  Serial.println(F("PN5180 Reader Task Demo Sketch"));
+
+  nfc.begin();
+
+  Serial.println(F("----------------------------------"));
+  Serial.println(F("PN5180 Hard-Reset..."));
+  if (!nfc.reset()) {
+    Serial.println(F("Initialization failed!?"));
+    Serial.println(F("Press reset to restart..."));
+    Serial.flush();
+    exit(-1); // halt
+  }
+  nfc.setupRF();
+
+  // other SPI devices take hal.getBusMutex() around their transfers
+  readerTask.pollInterval = 200;
+  if (!readerTask.start()) {
+    Serial.println(F("Reader task not started!?"));
+  }
+}
+
+void loop() {
+  PN5180Event event;
+  if (!readerTask.waitForEvent(&event, 1000)) {
+    return; // timeout, other work could be done here
+  }
+  Serial.print((PN5180_EVENT_TAG_ARRIVED == event.type) ? F("Tag arrived: ") : F("Tag left: "));
+  Serial.print((PN5180_TECH_ISO14443A == event.technology) ? F("ISO-14443 UID=") : F("ISO-15693 UID="));
+  for (int i=0; i<event.uidLength; i++) {
+    // ISO15693: LSB is first
+    uint8_t b = (PN5180_TECH_ISO15693 == event.technology) ? event.uid[event.uidLength-1-i] : event.uid[i];
+    Serial.print(b < 0x10 ? " 0" : " ");
+    Serial.print(b, HEX);
+  }
+  Serial.println();
+}
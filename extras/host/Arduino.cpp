@@ -0,0 +1,151 @@
+// NAME: Arduino.cpp
+//
+// DESC: Minimal Arduino API for building the library on a PC, see
+//       extras/host/Makefile.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// Built by the host Makefile only, other build systems compiling all
+// sources of the library skip it
+#ifdef PN5180_HOST
+
+#include <stdio.h>
+#include <time.h>
+#include <Arduino.h>
+#include <SPI.h>
+
+HostSerial Serial;
+SPIClass SPI;
+
+/*
+ * No GPIO on the host, the pins of the PN5180 are driven by MockPN5180
+ */
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t, uint8_t) {
+}
+
+int digitalRead(uint8_t) {
+  return LOW;
+}
+
+int digitalPinToInterrupt(uint8_t) {
+  return NOT_AN_INTERRUPT;
+}
+
+void attachInterrupt(int, void (*)(), int) {
+}
+
+void detachInterrupt(int) {
+}
+
+static unsigned long long monotonicUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+unsigned long millis() {
+  return (unsigned long)(monotonicUs() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)monotonicUs();
+}
+
+void delay(unsigned long ms) {
+  unsigned long long end = monotonicUs() + 1000ULL * ms;
+  while (monotonicUs() < end);
+}
+
+void delayMicroseconds(unsigned int us) {
+  unsigned long long end = monotonicUs() + us;
+  while (monotonicUs() < end);
+}
+
+void yield() {
+}
+
+void noInterrupts() {
+}
+
+void interrupts() {
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper *s) {
+  return print(reinterpret_cast<const char *>(s));
+}
+
+size_t Print::print(const char *s) {
+  return write((const uint8_t *)s, strlen(s));
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base) {
+  return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base) {
+  if ((DEC == base) && (n < 0)) {
+    return print('-') + print((unsigned long)-n, base);
+  }
+  return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), (HEX == base) ? "%lX" : "%lu", n);
+  return print(buf);
+}
+
+size_t Print::print(double n, int digits) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+size_t Print::println() {
+  return print("\r\n");
+}
+
+void HostSerial::flush() {
+  fflush(stdout);
+}
+
+size_t HostSerial::write(uint8_t c) {
+  return (EOF == putchar(c)) ? 0 : 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+#endif /* PN5180_HOST */
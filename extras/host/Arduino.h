@@ -0,0 +1,101 @@
+// NAME: Arduino.h
+//
+// DESC: Minimal Arduino API for building the library on a PC, see
+//       extras/host/Makefile. The host interface of the PN5180 is
+//       provided by a PN5180HAL (MockPN5180), the functions here only
+//       cover what the library and the default HAL reference.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define HIGH 1
+#define LOW  0
+#define INPUT  0
+#define OUTPUT 1
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define MSBFIRST 1
+#define NOT_AN_INTERRUPT -1
+// SPI pins, printed by PN5180::begin() in DEBUG builds
+#define SS   10
+#define MOSI 11
+#define MISO 12
+#define SCK  13
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// strings are not placed in flash on the host
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(int irq, void (*handler)(), int mode);
+void detachInterrupt(int irq);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+void noInterrupts();
+void interrupts();
+
+inline bool isPrintable(int c) { return (0 != isprint(c)); }
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+
+  size_t print(const __FlashStringHelper *s);
+  size_t print(const char *s);
+  size_t print(char c);
+  size_t print(unsigned char n, int base = DEC);
+  size_t print(int n, int base = DEC);
+  size_t print(unsigned int n, int base = DEC);
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+
+  size_t println();
+  template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+  template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+};
+
+// writes to stdout
+class HostSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  void flush();
+  operator bool() { return true; }
+  virtual size_t write(uint8_t c);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+};
+
+extern HostSerial Serial;
+
+#endif /* ARDUINO_H */
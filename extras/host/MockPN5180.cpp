@@ -0,0 +1,809 @@
+// NAME: MockPN5180.cpp
+//
+// DESC: Simulated PN5180 behind the PN5180HAL interface, for running the
+//       library on a PC: host interface with BUSY timing, registers,
+//       IRQ_STATUS/RX_STATUS, EEPROM and scripted ISO14443A/ISO15693 tags.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// Built by the host Makefile only, other build systems compiling all
+// sources of the library skip it
+#ifdef PN5180_HOST
+
+#include <Arduino.h>
+#include "PN5180.h"
+#include "MockPN5180.h"
+
+// host interface commands
+#define CMD_WRITE_REGISTER          (0x00)
+#define CMD_WRITE_REGISTER_OR_MASK  (0x01)
+#define CMD_WRITE_REGISTER_AND_MASK (0x02)
+#define CMD_WRITE_REGISTER_MULTIPLE (0x03)
+#define CMD_READ_REGISTER           (0x04)
+#define CMD_WRITE_EEPROM            (0x06)
+#define CMD_READ_EEPROM             (0x07)
+#define CMD_SEND_DATA               (0x09)
+#define CMD_READ_DATA               (0x0A)
+#define CMD_SWITCH_MODE             (0x0B)
+#define CMD_MIFARE_AUTHENTICATE     (0x0C)
+#define CMD_LOAD_RF_CONFIG          (0x11)
+#define CMD_RF_ON                   (0x16)
+#define CMD_RF_OFF                  (0x17)
+
+// typical times in ns
+#define PIN_READ_NS          200ULL      // digitalRead() of the host
+#define TIMER_READ_NS        50ULL       // micros()/millis() of the host
+#define BOOT_NS              2000000ULL  // reset until IDLE_IRQ
+#define REGISTER_NS          10000ULL    // register commands, SEND_DATA, READ_DATA
+#define EEPROM_READ_NS       30000ULL
+#define EEPROM_WRITE_NS      5000000ULL
+#define RF_CONFIG_NS         400000ULL
+#define RF_ON_NS             300000ULL   // RF_ON until TX_RFON_IRQ
+#define RF_OFF_NS            20000ULL
+#define MIFARE_AUTH_NS       1500000ULL
+#define RESPONSE_READ_NS     1000ULL     // BUSY after reading a response
+// ISO14443A 106 kbit/s
+#define A_BIT_NS             9440ULL
+#define A_FDT_NS             86000ULL    // end of the request until the answer
+// ISO15693 high data rate: 1 out of 4 from the reader, 26.48 kbit/s from the tag
+#define V_TX_BYTE_NS         302080ULL
+#define V_TX_SOF_EOF_NS      113280ULL
+#define V_RX_BYTE_NS         302080ULL
+#define V_RX_SOF_EOF_NS      113280ULL
+#define V_FDT_NS             320900ULL   // t1
+
+// tag states
+#define TAG_IDLE    0
+#define TAG_READY   1                  // ISO15693: quiet
+#define TAG_ACTIVE  2
+#define TAG_HALT    3
+
+MockPN5180::MockPN5180(uint8_t nssPin, uint8_t busyPin, uint8_t rstPin, uint8_t irqPin) {
+  this->nssPin = nssPin;
+  this->busyPin = busyPin;
+  this->rstPin = rstPin;
+  this->irqPin = irqPin;
+  irqHandler = 0;
+  now = 0;
+  spiClock = PN5180_SPI_CLOCK;
+  numTags = 0;
+  nssLow = false;
+  inReset = false;
+  frameLen = 0;
+
+  // EEPROM: die identifier, version block, IRQ pin active high
+  memset(eeprom, 0, sizeof(eeprom));
+  for (uint8_t i = 0; i < 16; i++) eeprom[DIE_IDENTIFIER + i] = 0xA0 + i;
+  eeprom[PRODUCT_VERSION] = 0x05;
+  eeprom[PRODUCT_VERSION + 1] = 0x03;
+  eeprom[FIRMWARE_VERSION] = 0x05;
+  eeprom[FIRMWARE_VERSION + 1] = 0x03;
+  eeprom[EEPROM_VERSION] = 0x00;
+  eeprom[EEPROM_VERSION + 1] = 0x99;
+  eeprom[IRQ_PIN_CONFIG] = 0x01;
+
+  powerUp();
+  bootDoneAt = 0;
+  irqStatus = IDLE_IRQ_STAT;
+  resetCounters();
+}
+
+/*
+ * Tag types of NFC Forum Type 2 (sak 0x00) or MIFARE Classic (sak 0x08)
+ */
+int8_t MockPN5180::addTagISO14443A(const uint8_t *uid, uint8_t uidLength, uint8_t sak,
+                                   uint16_t atqa, uint16_t numPages) {
+  if ((numTags >= MOCK_PN5180_MAX_TAGS) || ((uidLength != 4) && (uidLength != 7) && (uidLength != 10)))
+    return -1;
+  MockTag *tag = &tags[numTags];
+  memset(tag, 0, sizeof(MockTag));
+  tag->type = MOCK_TAG_ISO14443A;
+  tag->inField = true;
+  memcpy(tag->uid, uid, uidLength);
+  tag->uidLength = uidLength;
+  tag->atqa[0] = (uint8_t)atqa;
+  tag->atqa[1] = (uint8_t)(atqa >> 8);
+  tag->sak = sak;
+  tag->blockSize = 4;
+  tag->numBlocks = (numPages * 4 > MOCK_PN5180_TAG_MEMORY) ? MOCK_PN5180_TAG_MEMORY / 4 : numPages;
+  // Type 2: UID and check bytes in pages 0..2
+  if (7 == uidLength) {
+    tag->memory[0] = uid[0]; tag->memory[1] = uid[1]; tag->memory[2] = uid[2];
+    tag->memory[3] = 0x88 ^ uid[0] ^ uid[1] ^ uid[2];
+    tag->memory[4] = uid[3]; tag->memory[5] = uid[4]; tag->memory[6] = uid[5]; tag->memory[7] = uid[6];
+    tag->memory[8] = uid[3] ^ uid[4] ^ uid[5] ^ uid[6];
+  }
+  return numTags++;
+}
+
+/*
+ * uid LSB first, as returned by getInventory()
+ */
+int8_t MockPN5180::addTagISO15693(const uint8_t *uid, uint8_t blockSize, uint16_t numBlocks) {
+  if ((numTags >= MOCK_PN5180_MAX_TAGS) || (0 == blockSize) || (numBlocks > 256))
+    return -1;
+  MockTag *tag = &tags[numTags];
+  memset(tag, 0, sizeof(MockTag));
+  tag->type = MOCK_TAG_ISO15693;
+  tag->inField = true;
+  memcpy(tag->uid, uid, 8);
+  tag->uidLength = 8;
+  tag->blockSize = blockSize;
+  tag->numBlocks = (blockSize * numBlocks > MOCK_PN5180_TAG_MEMORY) ? MOCK_PN5180_TAG_MEMORY / blockSize : numBlocks;
+  for (uint16_t i = 0; i < MOCK_PN5180_TAG_MEMORY; i++) tag->memory[i] = (uint8_t)i;
+  return numTags++;
+}
+
+MockTag *MockPN5180::getTag(int8_t index) {
+  return ((index >= 0) && (index < numTags)) ? &tags[index] : 0;
+}
+
+/*
+ * A tag leaving the field loses its state
+ */
+void MockPN5180::setTagInField(int8_t index, bool inField) {
+  MockTag *tag = getTag(index);
+  if (tag) {
+    tag->inField = inField;
+    tag->state = TAG_IDLE;
+  }
+}
+
+void MockPN5180::resetCounters() {
+  memset(&counters, 0, sizeof(counters));
+}
+
+const MockPN5180Counters &MockPN5180::getCounters() {
+  return counters;
+}
+
+unsigned long long MockPN5180::getTimeNs() {
+  return now;
+}
+
+void MockPN5180::spiBegin() {
+}
+
+void MockPN5180::spiEnd() {
+}
+
+void MockPN5180::setSPIClock(uint32_t clock) {
+  spiClock = clock ? clock : 1;
+}
+
+void MockPN5180::beginTransaction() {
+  counters.transactions++;
+}
+
+void MockPN5180::endTransaction() {
+}
+
+void MockPN5180::spiWrite(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (frameLen < sizeof(frame)) frame[frameLen++] = data[i];
+  }
+  counters.bytesSent += len;
+  framePending = true;
+  advance(8000000000ULL * len / spiClock);
+}
+
+/*
+ * A response is read in one or several transfers within one NSS low period
+ */
+void MockPN5180::spiRead(uint8_t *buffer, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    buffer[i] = (readFrame && (frameLen < responseLen)) ? response[frameLen] : 0xff;
+    frameLen++;
+  }
+  counters.bytesReceived += len;
+  framePending = true;
+  advance(8000000000ULL * len / spiClock);
+}
+
+void MockPN5180::setPinMode(uint8_t, uint8_t) {
+}
+
+void MockPN5180::writePin(uint8_t pin, uint8_t value) {
+  if (pin == nssPin) {
+    if ((LOW == value) && !nssLow) {
+      nssLow = true;
+      framePending = false;
+      readFrame = responsePending;
+      frameLen = 0;
+      counters.spiFrames++;
+    }
+    else if ((HIGH == value) && nssLow) {
+      nssLow = false;
+      if (framePending) {
+        if (readFrame) {
+          responsePending = false;
+          busyUntil = now + RESPONSE_READ_NS;
+        }
+        else {
+          processCommand();
+        }
+      }
+      framePending = false;
+    }
+  }
+  else if (pin == rstPin) {
+    if (LOW == value) {
+      inReset = true;
+      powerUp();
+    }
+    else if (inReset) {
+      inReset = false;
+      bootDoneAt = now + BOOT_NS;
+    }
+  }
+}
+
+/*
+ * BUSY is high from the end of an SPI frame until NSS is high again and
+ * the command has been processed, and while booting
+ */
+int MockPN5180::readPin(uint8_t pin) {
+  advance(PIN_READ_NS);
+  if (pin == busyPin) {
+    counters.busyPolls++;
+    if (inReset || bootDoneAt || (nssLow && framePending) || (!nssLow && (now < busyUntil)))
+      return HIGH;
+    return LOW;
+  }
+  if (pin == irqPin) {
+    counters.irqPolls++;
+    return irqLine ? HIGH : LOW;
+  }
+  return LOW;
+}
+
+unsigned long MockPN5180::getMillis() {
+  advance(TIMER_READ_NS);
+  return (unsigned long)(now / 1000000ULL);
+}
+
+unsigned long MockPN5180::getMicros() {
+  advance(TIMER_READ_NS);
+  return (unsigned long)(now / 1000ULL);
+}
+
+void MockPN5180::delayUs(unsigned int us) {
+  advance(1000ULL * us);
+}
+
+bool MockPN5180::attachIRQ(uint8_t pin, void (*handler)()) {
+  if ((PN5180_NO_IRQ_PIN == irqPin) || (pin != irqPin))
+    return false;
+  irqHandler = handler;
+  return true;
+}
+
+void MockPN5180::detachIRQ(uint8_t) {
+  irqHandler = 0;
+}
+
+void MockPN5180::advance(unsigned long long ns) {
+  now += ns;
+  update();
+}
+
+/*
+ * Applies the events which are due and drives the IRQ line, the handler
+ * is called on its rising edge as by attachInterrupt()
+ */
+void MockPN5180::update() {
+  if (bootDoneAt && (now >= bootDoneAt)) {
+    bootDoneAt = 0;
+    irqStatus |= IDLE_IRQ_STAT;
+  }
+  if (rfOnAt && (now >= rfOnAt)) {
+    rfOnAt = 0;
+    irqStatus |= TX_RFON_IRQ_STAT;
+  }
+  if (rfOffAt && (now >= rfOffAt)) {
+    rfOffAt = 0;
+    irqStatus |= TX_RFOFF_IRQ_STAT;
+  }
+  if (txDoneAt && (now >= txDoneAt)) {
+    txDoneAt = 0;
+    irqStatus |= TX_IRQ_STAT;
+    transceiveState = PN5180_TS_WaitReceive;
+  }
+  if (sofAt && (now >= sofAt)) {
+    sofAt = 0;
+    irqStatus |= RX_SOF_DET_IRQ_STAT;
+    transceiveState = PN5180_TS_Receiving;
+  }
+  if (rxDoneAt && (now >= rxDoneAt)) {
+    rxDoneAt = 0;
+    memcpy(rxBuffer, pendingRx, pendingRxLen);
+    rxStatus = pendingRxStatus;
+    irqStatus |= RX_IRQ_STAT;
+    // the initiator waits for the next frame within the transceive cycle
+    transceiveState = PN5180_TS_WaitTransmit;
+  }
+
+  bool line = (0 != (irqStatus & registers[IRQ_ENABLE]));
+  bool rising = line && !irqLine;
+  irqLine = line;
+  if (rising && irqHandler) irqHandler();
+}
+
+/*
+ * State after power on or reset, the tags lose the field
+ */
+void MockPN5180::powerUp() {
+  memset(registers, 0, sizeof(registers));
+  irqStatus = 0;
+  irqLine = false;
+  rfTxConfig = 0xff;
+  rfOn = false;
+  transceiveState = PN5180_TS_Idle;
+  rxStatus = 0;
+  bootDoneAt = 0;
+  rfOnAt = 0;
+  rfOffAt = 0;
+  txDoneAt = 0;
+  sofAt = 0;
+  rxDoneAt = 0;
+  busyUntil = 0;
+  framePending = false;
+  readFrame = false;
+  responsePending = false;
+  responseLen = 0;
+  inventorySlot = 16;
+  for (uint8_t i = 0; i < numTags; i++) tags[i].state = TAG_IDLE;
+}
+
+void MockPN5180::processCommand() {
+  uint8_t op = frame[0];
+  counters.commands++;
+  counters.command[op & 0x1f]++;
+  unsigned long long duration = REGISTER_NS;
+
+  switch (op) {
+    case CMD_WRITE_REGISTER:
+    case CMD_WRITE_REGISTER_OR_MASK:
+    case CMD_WRITE_REGISTER_AND_MASK:
+      if (6 == frameLen) {
+        uint32_t value = frame[2] | ((uint32_t)frame[3] << 8) | ((uint32_t)frame[4] << 16) | ((uint32_t)frame[5] << 24);
+        writeRegister(frame[1], op + 1, value);
+      }
+      else irqStatus |= GENERAL_ERROR_IRQ_STAT;
+      break;
+    case CMD_WRITE_REGISTER_MULTIPLE:
+      for (uint16_t pos = 1; pos + 6 <= frameLen; pos += 6) {
+        uint32_t value = frame[pos+2] | ((uint32_t)frame[pos+3] << 8) |
+                         ((uint32_t)frame[pos+4] << 16) | ((uint32_t)frame[pos+5] << 24);
+        writeRegister(frame[pos], frame[pos+1], value);
+      }
+      break;
+    case CMD_READ_REGISTER: {
+      uint32_t value = readRegister(frame[1]);
+      for (uint8_t i = 0; i < 4; i++) response[i] = (uint8_t)(value >> (8 * i));
+      responseLen = 4;
+      responsePending = true;
+      break;
+    }
+    case CMD_WRITE_EEPROM:
+      for (uint16_t i = 2; (i < frameLen) && (frame[1] + i - 2 < 255); i++) eeprom[frame[1] + i - 2] = frame[i];
+      duration = EEPROM_WRITE_NS;
+      break;
+    case CMD_READ_EEPROM:
+      responseLen = frame[2];
+      memcpy(response, &eeprom[frame[1]], responseLen);
+      responsePending = true;
+      duration = EEPROM_READ_NS;
+      break;
+    case CMD_SEND_DATA:
+      sendRF(frame + 2, (frameLen > 2) ? frameLen - 2 : 0, frame[1]);
+      break;
+    case CMD_READ_DATA:
+      memcpy(response, rxBuffer, sizeof(rxBuffer));
+      responseLen = sizeof(rxBuffer);
+      responsePending = true;
+      break;
+    case CMD_SWITCH_MODE:
+      break;
+    case CMD_MIFARE_AUTHENTICATE: {
+      response[0] = MIFARE_AUTH_TIMEOUT;
+      for (uint8_t i = 0; i < numTags; i++) {
+        if ((MOCK_TAG_ISO14443A == tags[i].type) && (TAG_ACTIVE == tags[i].state) && (tags[i].sak & 0x08)) {
+          response[0] = MIFARE_AUTH_OK;
+          registers[SYSTEM_CONFIG] |= MFC_CRYPTO_ON;
+        }
+      }
+      responseLen = 1;
+      responsePending = true;
+      duration = MIFARE_AUTH_NS;
+      break;
+    }
+    case CMD_LOAD_RF_CONFIG:
+      if (0xff != frame[1]) rfTxConfig = frame[1];
+      duration = RF_CONFIG_NS;
+      break;
+    case CMD_RF_ON:
+      if (!rfOn) {
+        rfOn = true;
+        rfOnAt = now + RF_ON_NS;
+      }
+      break;
+    case CMD_RF_OFF:
+      rfOn = false;
+      rfOffAt = now + RF_OFF_NS;
+      inventorySlot = 16;
+      for (uint8_t i = 0; i < numTags; i++) tags[i].state = TAG_IDLE;
+      break;
+    default:
+      irqStatus |= GENERAL_ERROR_IRQ_STAT;
+      break;
+  }
+  if (irqStatus & GENERAL_ERROR_IRQ_STAT) counters.errors++;
+  busyUntil = now + duration;
+  update();
+}
+
+uint32_t MockPN5180::readRegister(uint8_t reg) {
+  switch (reg) {
+    case IRQ_STATUS: return irqStatus;
+    case RX_STATUS:  return rxStatus;
+    case RF_STATUS:  return ((uint32_t)transceiveState << 24);
+    default:         return (reg < 0x40) ? registers[reg] : 0;
+  }
+}
+
+/*
+ * action: 1 = write, 2 = OR mask, 3 = AND mask (WRITE_REGISTER_MULTIPLE)
+ */
+void MockPN5180::writeRegister(uint8_t reg, uint8_t action, uint32_t value) {
+  if (reg >= 0x40) {
+    irqStatus |= GENERAL_ERROR_IRQ_STAT;
+    return;
+  }
+  uint32_t old = (IRQ_STATUS == reg) ? irqStatus : registers[reg];
+  if (2 == action) value |= old;
+  else if (3 == action) value &= old;
+
+  if (IRQ_CLEAR == reg) {
+    irqStatus &= ~value;
+    return;
+  }
+  if (IRQ_STATUS == reg) // read only
+    return;
+  if (SYSTEM_CONFIG == reg) {
+    uint8_t command = value & 0x07;
+    if ((0 == command) || ((3 == command) && (3 != (old & 0x07)))) {
+      // IDLE ends, TRANSCEIVE restarts the cycle
+      transceiveState = (3 == command) ? PN5180_TS_WaitTransmit : PN5180_TS_Idle;
+      txDoneAt = 0;
+      sofAt = 0;
+      rxDoneAt = 0;
+    }
+  }
+  registers[reg] = value;
+}
+
+bool MockPN5180::isISO15693Config() {
+  return (0x0D == rfTxConfig) || (0x0E == rfTxConfig);
+}
+
+/*
+ * Transmits the frame and schedules TX_IRQ, RX_SOF_DET_IRQ and RX_IRQ of
+ * the answer of the tags
+ */
+void MockPN5180::sendRF(const uint8_t *data, uint16_t len, uint8_t validBits) {
+  counters.rfFrames++;
+  if (!rfOn || (PN5180_TS_WaitTransmit != transceiveState)) {
+    irqStatus |= GENERAL_ERROR_IRQ_STAT;
+    return;
+  }
+  transceiveState = PN5180_TS_Transmitting;
+  rxStatus = 0;
+  pendingRxStatus = 0;
+  pendingRxLen = 0;
+  unsigned long long txNs, fdtNs, rxNs;
+
+  if (isISO15693Config()) {
+    if ((0 == len) && (inventorySlot < 15)) {
+      // EOF only, next slot of the 16 slot inventory
+      pendingRxLen = answerInventorySlot(++inventorySlot, pendingRx, &pendingRxStatus);
+    }
+    else {
+      inventorySlot = 16;
+      pendingRxLen = answerISO15693(data, len, pendingRx, &pendingRxStatus);
+    }
+    txNs = (len ? (len + 2) * V_TX_BYTE_NS : 0) + V_TX_SOF_EOF_NS;
+    fdtNs = V_FDT_NS;
+    rxNs = (pendingRxLen + 2) * V_RX_BYTE_NS + V_RX_SOF_EOF_NS;
+  }
+  else if (rfTxConfig <= 0x03) {
+    pendingRxLen = answerISO14443A(data, len, validBits, pendingRx, &pendingRxStatus);
+    uint16_t txBits = 8 * len - (validBits ? (8 - validBits) : 0);
+    uint16_t crc = (registers[CRC_TX_CONFIG] & 0x01) ? 2 : 0;
+    txNs = (txBits + len + 9 * crc + 2) * A_BIT_NS;
+    fdtNs = A_FDT_NS;
+    crc = (registers[CRC_RX_CONFIG] & 0x01) ? 2 : 0;
+    rxNs = (9 * (pendingRxLen + crc) + 2) * A_BIT_NS;
+  }
+  else {
+    // no tags of other technologies
+    txNs = (8 * len + 2) * A_BIT_NS;
+    fdtNs = 0;
+    rxNs = 0;
+  }
+
+  txDoneAt = now + txNs;
+  if (pendingRxLen > 0) {
+    pendingRxStatus |= pendingRxLen;
+    sofAt = txDoneAt + fdtNs;
+    rxDoneAt = sofAt + rxNs;
+  }
+}
+
+/*
+ * CL bytes of a cascade level: CT + 3 UID bytes or the last 4 UID bytes,
+ * and BCC
+ */
+void MockPN5180::cascadeBytes(MockTag *tag, uint8_t level, uint8_t *cl) {
+  uint8_t levels = (4 == tag->uidLength) ? 1 : ((7 == tag->uidLength) ? 2 : 3);
+  if (level + 1 < levels) {
+    cl[0] = 0x88;
+    for (uint8_t i = 0; i < 3; i++) cl[1 + i] = tag->uid[3 * level + i];
+  }
+  else {
+    for (uint8_t i = 0; i < 4; i++) cl[i] = tag->uid[3 * level + i];
+  }
+  cl[4] = cl[0] ^ cl[1] ^ cl[2] ^ cl[3];
+}
+
+uint16_t MockPN5180::answerISO14443A(const uint8_t *data, uint16_t len, uint8_t validBits, uint8_t *rx, uint32_t *status) {
+  // REQA/WUPA: idle (and with WUPA halted) tags get ready
+  if ((1 == len) && (7 == validBits) && ((0x26 == data[0]) || (0x52 == data[0]))) {
+    uint8_t answers = 0;
+    rx[0] = 0;
+    rx[1] = 0;
+    for (uint8_t i = 0; i < numTags; i++) {
+      MockTag *tag = &tags[i];
+      if ((MOCK_TAG_ISO14443A != tag->type) || !tag->inField) continue;
+      if ((TAG_HALT == tag->state) && (0x26 == data[0])) continue;
+      tag->state = TAG_READY;
+      tag->cascadeLevel = 0;
+      rx[0] |= tag->atqa[0];
+      rx[1] |= tag->atqa[1];
+      answers++;
+    }
+    if (answers > 1) *status |= RX_COLLISION_DETECTED;
+    return answers ? 2 : 0;
+  }
+
+  // anticollision and SELECT of a cascade level
+  if ((len >= 2) && ((0x93 == data[0]) || (0x95 == data[0]) || (0x97 == data[0]))) {
+    uint8_t level = (data[0] - 0x93) / 2;
+    uint8_t nvb = data[1];
+    uint8_t cl[5];
+
+    if ((0x70 == nvb) && (7 == len)) {
+      MockTag *selected = 0;
+      for (uint8_t i = 0; i < numTags; i++) {
+        MockTag *tag = &tags[i];
+        if ((MOCK_TAG_ISO14443A != tag->type) || !tag->inField || (TAG_READY != tag->state) ||
+            (tag->cascadeLevel != level)) continue;
+        cascadeBytes(tag, level, cl);
+        if (0 == memcmp(cl, data + 2, 5)) selected = tag;
+        else tag->state = TAG_IDLE;
+      }
+      if (!selected)
+        return 0;
+      if (0x88 == data[2]) {
+        selected->cascadeLevel++;
+        rx[0] = 0x04; // UID not complete
+      }
+      else {
+        selected->state = TAG_ACTIVE;
+        rx[0] = selected->sak;
+      }
+      return 1;
+    }
+
+    uint8_t knownBits = 8 * ((nvb >> 4) - 2) + (nvb & 0x0f);
+    if ((nvb < 0x20) || (knownBits > 40) || (len < 2 + (knownBits + 7) / 8))
+      return 0;
+    uint8_t lastBits = knownBits % 8;
+    uint16_t rxLen = (lastBits + 40 - knownBits + 7) / 8;
+    memset(rx, 0, rxLen);
+    uint8_t answers = 0;
+    int16_t collision = -1;
+    uint8_t first[5];
+    for (uint8_t i = 0; i < numTags; i++) {
+      MockTag *tag = &tags[i];
+      if ((MOCK_TAG_ISO14443A != tag->type) || !tag->inField || (TAG_READY != tag->state) ||
+          (tag->cascadeLevel != level)) continue;
+      cascadeBytes(tag, level, cl);
+      bool match = true;
+      for (uint8_t b = 0; match && (b < knownBits); b++) {
+        match = (((cl[b / 8] ^ data[2 + b / 8]) >> (b % 8)) & 0x01) == 0;
+      }
+      if (!match) continue;
+      if (0 == answers) memcpy(first, cl, 5);
+      for (uint8_t b = knownBits; b < 40; b++) {
+        uint8_t bit = (cl[b / 8] >> (b % 8)) & 0x01;
+        uint8_t rxBit = lastBits + b - knownBits;
+        if ((answers > 0) && (collision < 0) && (bit != ((first[b / 8] >> (b % 8)) & 0x01)))
+          collision = b - knownBits;
+        if (bit) rx[rxBit / 8] |= (1 << (rxBit % 8));
+      }
+      answers++;
+    }
+    if (0 == answers)
+      return 0;
+    if (collision >= 0)
+      *status |= RX_COLLISION_DETECTED | ((uint32_t)collision << RX_COLL_POS_SHIFT);
+    return rxLen;
+  }
+
+  // commands of the selected tag
+  MockTag *tag = 0;
+  for (uint8_t i = 0; i < numTags; i++) {
+    if ((MOCK_TAG_ISO14443A == tags[i].type) && tags[i].inField && (TAG_ACTIVE == tags[i].state))
+      tag = &tags[i];
+  }
+  if (!tag)
+    return 0;
+  uint16_t memorySize = 4 * tag->numBlocks;
+
+  if ((2 == len) && (0x50 == data[0]) && (0x00 == data[1])) { // HLTA
+    tag->state = TAG_HALT;
+    return 0;
+  }
+  if ((2 == len) && (0x30 == data[0])) { // READ, rolls over at the end of the memory
+    for (uint8_t i = 0; i < 16; i++) rx[i] = tag->memory[(4 * data[1] + i) % memorySize];
+    return 16;
+  }
+  if ((3 == len) && (0x3A == data[0])) { // FAST_READ
+    if ((data[2] < data[1]) || (data[2] >= tag->numBlocks))
+      return 0;
+    uint16_t rxLen = 4 * (data[2] - data[1] + 1);
+    memcpy(rx, &tag->memory[4 * data[1]], rxLen);
+    return rxLen;
+  }
+  if ((1 == len) && (0x60 == data[0])) { // GET_VERSION, NTAG213/215/216
+    const uint8_t version[8] = { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x0F, 0x03 };
+    memcpy(rx, version, 8);
+    if (tag->numBlocks > 45) rx[6] = 0x11;
+    if (tag->numBlocks > 135) rx[6] = 0x13;
+    return 8;
+  }
+  if ((6 == len) && (0xA2 == data[0])) { // WRITE, ACK is 4 bits
+    if (data[1] >= tag->numBlocks)
+      return 0;
+    memcpy(&tag->memory[4 * data[1]], data + 2, 4);
+    rx[0] = 0x0A;
+    return 1;
+  }
+  return 0;
+}
+
+uint16_t MockPN5180::answerISO15693(const uint8_t *data, uint16_t len, uint8_t *rx, uint32_t *status) {
+  if (len < 2)
+    return 0;
+  uint8_t flags = data[0];
+  uint8_t command = data[1];
+
+  if ((flags & 0x04) && (0x01 == command)) { // inventory
+    uint8_t pos = (flags & 0x10) ? 3 : 2; // AFI ignored
+    if (pos >= len)
+      return 0;
+    inventoryMaskLen = data[pos++];
+    if (inventoryMaskLen > 64)
+      return 0;
+    memset(inventoryMask, 0, sizeof(inventoryMask));
+    memcpy(inventoryMask, data + pos, (inventoryMaskLen + 7) / 8);
+    if (flags & 0x20) { // 1 slot
+      return answerInventorySlot(16, rx, status);
+    }
+    inventorySlot = 0;
+    return answerInventorySlot(0, rx, status);
+  }
+
+  // addressed or to the tag in the field
+  MockTag *tag = 0;
+  uint8_t pos = 2;
+  for (uint8_t i = 0; i < numTags; i++) {
+    if ((MOCK_TAG_ISO15693 != tags[i].type) || !tags[i].inField) continue;
+    if (flags & 0x20) {
+      if ((len >= 10) && (0 == memcmp(tags[i].uid, data + 2, 8))) tag = &tags[i];
+    }
+    else if ((TAG_READY != tags[i].state) && !tag) tag = &tags[i];
+  }
+  if (!tag)
+    return 0;
+  if (flags & 0x20) pos = 10;
+  bool option = (0 != (flags & 0x40));
+  uint16_t rxLen = 0;
+  rx[rxLen++] = 0x00;
+
+  switch (command) {
+    case 0x02: // STAY QUIET
+      tag->state = TAG_READY;
+      return 0;
+    case 0x20: // READ SINGLE BLOCK
+    case 0x23: { // READ MULTIPLE BLOCKS
+      uint16_t first = (pos < len) ? data[pos] : 0xffff;
+      uint16_t count = (0x23 == command) ? ((pos + 1 < len) ? data[pos + 1] + 1 : 0xffff) : 1;
+      if ((first + count > tag->numBlocks) || (1U + count * (tag->blockSize + 1) > sizeof(pendingRx))) {
+        rx[0] = 0x01;
+        rx[1] = 0x10; // block not available
+        return 2;
+      }
+      for (uint16_t b = first; b < first + count; b++) {
+        if (option) rx[rxLen++] = 0x00; // block security status
+        memcpy(rx + rxLen, &tag->memory[b * tag->blockSize], tag->blockSize);
+        rxLen += tag->blockSize;
+      }
+      return rxLen;
+    }
+    case 0x21: // WRITE SINGLE BLOCK
+      if ((pos + 1 + tag->blockSize > len) || (data[pos] >= tag->numBlocks)) {
+        rx[0] = 0x01;
+        rx[1] = 0x10;
+        return 2;
+      }
+      memcpy(&tag->memory[data[pos] * tag->blockSize], data + pos + 1, tag->blockSize);
+      return 1;
+    case 0x26: // RESET TO READY
+      tag->state = TAG_IDLE;
+      return 1;
+    case 0x2B: // GET SYSTEM INFO
+      rx[rxLen++] = 0x0F; // DSFID, AFI, memory size and IC reference present
+      memcpy(rx + rxLen, tag->uid, 8);
+      rxLen += 8;
+      rx[rxLen++] = 0x00; // DSFID
+      rx[rxLen++] = 0x00; // AFI
+      rx[rxLen++] = (uint8_t)(tag->numBlocks - 1);
+      rx[rxLen++] = tag->blockSize - 1;
+      rx[rxLen++] = 0x01; // IC reference
+      return rxLen;
+    default:
+      rx[0] = 0x01;
+      rx[1] = 0x01; // not supported
+      return 2;
+  }
+}
+
+/*
+ * Tags matching the inventory mask and, if slot < 16, the slot number in
+ * the 4 bits following the mask. Several answers collide.
+ */
+uint16_t MockPN5180::answerInventorySlot(uint8_t slot, uint8_t *rx, uint32_t *status) {
+  uint8_t answers = 0;
+  memset(rx, 0, 10);
+  for (uint8_t i = 0; i < numTags; i++) {
+    MockTag *tag = &tags[i];
+    if ((MOCK_TAG_ISO15693 != tag->type) || !tag->inField || (TAG_READY == tag->state)) continue;
+    bool match = true;
+    for (uint8_t b = 0; match && (b < inventoryMaskLen); b++) {
+      match = (((tag->uid[b / 8] ^ inventoryMask[b / 8]) >> (b % 8)) & 0x01) == 0;
+    }
+    for (uint8_t b = 0; match && (slot < 16) && (b < 4); b++) {
+      uint8_t uidBit = inventoryMaskLen + b;
+      match = (uidBit >= 64) || ((((tag->uid[uidBit / 8] >> (uidBit % 8)) ^ (slot >> b)) & 0x01) == 0);
+    }
+    if (!match) continue;
+    for (uint8_t b = 0; b < 8; b++) rx[2 + b] |= tag->uid[b];
+    answers++;
+  }
+  if (answers > 1) *status |= RX_COLLISION_DETECTED | RX_DATA_INTEGRITY_ERROR;
+  return answers ? 10 : 0;
+}
+
+#endif /* PN5180_HOST */
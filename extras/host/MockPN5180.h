@@ -0,0 +1,186 @@
+// NAME: MockPN5180.h
+//
+// DESC: Simulated PN5180 behind the PN5180HAL interface, for running the
+//       library on a PC: host interface with BUSY timing, registers,
+//       IRQ_STATUS/RX_STATUS, EEPROM and scripted ISO14443A/ISO15693 tags.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef MOCKPN5180_H
+#define MOCKPN5180_H
+
+#include "PN5180HAL.h"
+
+// tags in the field of the mock
+#ifndef MOCK_PN5180_MAX_TAGS
+#define MOCK_PN5180_MAX_TAGS 4
+#endif
+// memory of one tag in bytes
+#ifndef MOCK_PN5180_TAG_MEMORY
+#define MOCK_PN5180_TAG_MEMORY 256
+#endif
+
+enum MockTagType {
+  MOCK_TAG_ISO14443A = 0,
+  MOCK_TAG_ISO15693 = 1
+};
+
+/*
+ * A tag of the script. ISO14443A tags answer REQA/WUPA, anticollision,
+ * SELECT, HLTA and the NFC Type 2 commands READ, FAST_READ and GET_VERSION
+ * (memory in pages of 4 bytes). ISO15693 tags answer inventory (1 and 16
+ * slots), STAY QUIET, READ/WRITE SINGLE BLOCK, READ MULTIPLE BLOCKS and
+ * GET SYSTEM INFO.
+ */
+struct MockTag {
+  MockTagType type;
+  bool inField;
+  uint8_t uid[10];     // ISO15693: 8 bytes, LSB first
+  uint8_t uidLength;
+  uint8_t atqa[2];
+  uint8_t sak;
+  uint8_t blockSize;   // ISO14443A: 4 (page size)
+  uint16_t numBlocks;
+  uint8_t memory[MOCK_PN5180_TAG_MEMORY];
+  // protocol state, reset when the field is switched off
+  uint8_t state;
+  uint8_t cascadeLevel;
+};
+
+/*
+ * Counted since the last resetCounters(), the measures of the benchmark
+ */
+struct MockPN5180Counters {
+  uint32_t commands;        // host interface commands (SPI frames written)
+  uint32_t command[0x20];   // by opcode
+  uint32_t transactions;    // beginTransaction() calls
+  uint32_t spiFrames;       // NSS low periods, commands and responses
+  uint32_t bytesSent;
+  uint32_t bytesReceived;
+  uint32_t busyPolls;       // reads of the BUSY line
+  uint32_t irqPolls;        // reads of the IRQ line
+  uint32_t rfFrames;        // SEND_DATA commands
+  uint32_t errors;          // commands raising GENERAL_ERROR_IRQ
+};
+
+/*
+ * The clock is simulated: it advances with each SPI byte (at the clock set
+ * by setSPIClock), each pin read, delayUs() and while waiting for the
+ * processing time of a command. RF timing follows ISO14443A at 106 kbit/s
+ * and ISO15693 at high data rate. Processing times are typical values,
+ * the results are meant for comparing two versions of the library.
+ * The same pin numbers as for the PN5180 constructor have to be given,
+ * irqPin PN5180_NO_IRQ_PIN if the IRQ line is not connected.
+ */
+class MockPN5180 : public PN5180HAL {
+public:
+  MockPN5180(uint8_t nssPin, uint8_t busyPin, uint8_t rstPin, uint8_t irqPin);
+
+  // script, return value: tag index, -1 if all slots are used
+  int8_t addTagISO14443A(const uint8_t *uid, uint8_t uidLength, uint8_t sak = 0x00,
+                         uint16_t atqa = 0x0044, uint16_t numPages = 45);
+  int8_t addTagISO15693(const uint8_t *uid, uint8_t blockSize = 4, uint16_t numBlocks = 64);
+  MockTag *getTag(int8_t index);
+  void setTagInField(int8_t index, bool inField);
+
+  void resetCounters();
+  const MockPN5180Counters &getCounters();
+  unsigned long long getTimeNs();
+
+  virtual void spiBegin();
+  virtual void spiEnd();
+  virtual void setSPIClock(uint32_t clock);
+  virtual void beginTransaction();
+  virtual void endTransaction();
+  virtual void spiWrite(const uint8_t *data, size_t len);
+  virtual void spiRead(uint8_t *buffer, size_t len);
+
+  virtual void setPinMode(uint8_t pin, uint8_t mode);
+  virtual void writePin(uint8_t pin, uint8_t value);
+  virtual int readPin(uint8_t pin);
+
+  virtual unsigned long getMillis();
+  virtual unsigned long getMicros();
+  virtual void delayUs(unsigned int us);
+
+  virtual bool attachIRQ(uint8_t pin, void (*handler)());
+  virtual void detachIRQ(uint8_t pin);
+
+private:
+  uint8_t nssPin;
+  uint8_t busyPin;
+  uint8_t rstPin;
+  uint8_t irqPin;
+  void (*irqHandler)();
+
+  unsigned long long now;      // simulated time in ns
+  uint32_t spiClock;
+  MockPN5180Counters counters;
+
+  // host interface
+  bool nssLow;
+  bool inReset;
+  bool framePending;           // bytes transferred in this NSS low period
+  bool readFrame;              // this NSS low period reads a response
+  unsigned long long busyUntil;
+  uint8_t frame[1 + 6 * 32 + 260];
+  uint16_t frameLen;
+  uint8_t response[512];
+  uint16_t responseLen;
+  bool responsePending;
+
+  // chip state
+  uint32_t registers[0x40];
+  uint8_t eeprom[256];
+  uint32_t irqStatus;
+  bool irqLine;
+  uint8_t rfTxConfig;
+  bool rfOn;
+  uint8_t transceiveState;     // RF_STATUS.TRANSCEIVE_STATE
+  uint8_t rxBuffer[508];
+  uint32_t rxStatus;
+  // events of the running RF exchange, 0 = none
+  unsigned long long bootDoneAt;
+  unsigned long long rfOnAt;
+  unsigned long long rfOffAt;
+  unsigned long long txDoneAt;
+  unsigned long long sofAt;
+  unsigned long long rxDoneAt;
+  uint8_t pendingRx[508];
+  uint16_t pendingRxLen;
+  uint32_t pendingRxStatus;
+
+  // ISO15693 16 slot inventory, slot 16 = none
+  uint8_t inventorySlot;
+  uint8_t inventoryMask[8];
+  uint8_t inventoryMaskLen;
+
+  MockTag tags[MOCK_PN5180_MAX_TAGS];
+  uint8_t numTags;
+
+  void advance(unsigned long long ns);
+  void update();
+  void powerUp();
+  void processCommand();
+  uint32_t readRegister(uint8_t reg);
+  void writeRegister(uint8_t reg, uint8_t action, uint32_t value);
+  void sendRF(const uint8_t *data, uint16_t len, uint8_t validBits);
+  bool isISO15693Config();
+
+  uint16_t answerISO14443A(const uint8_t *data, uint16_t len, uint8_t validBits, uint8_t *rx, uint32_t *status);
+  uint16_t answerISO15693(const uint8_t *data, uint16_t len, uint8_t *rx, uint32_t *status);
+  uint16_t answerInventorySlot(uint8_t slot, uint8_t *rx, uint32_t *status);
+  void cascadeBytes(MockTag *tag, uint8_t level, uint8_t *cl);
+};
+
+#endif /* MOCKPN5180_H */
@@ -0,0 +1,44 @@
+// NAME: SPI.h
+//
+// DESC: SPIClass without hardware for the host build. PN5180 sends all
+//       SPI transfers through its PN5180HAL, so this class is only there
+//       for the default arguments and PN5180ArduinoHAL.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+#ifndef SPI_H
+#define SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0x00
+
+class SPISettings {
+public:
+  SPISettings() {}
+  SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+class SPIClass {
+public:
+  void begin() {}
+  void end() {}
+  void beginTransaction(SPISettings) {}
+  void endTransaction() {}
+  uint8_t transfer(uint8_t) { return 0xff; }
+  void transfer(void *buffer, size_t count) { memset(buffer, 0xff, count); }
+};
+
+extern SPIClass SPI;
+
+#endif /* SPI_H */
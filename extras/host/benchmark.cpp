@@ -0,0 +1,296 @@
+// NAME: benchmark.cpp
+//
+// DESC: Host benchmark of the library against MockPN5180: host interface
+//       commands, SPI transactions, bytes and simulated time per call of
+//       activateTypeA, getInventory, readSingleBlock, getSystemInfo,
+//       PN5180ISO15693Cache, PN5180NDEF and others.
+//       Exits with 1 if an operation returned a wrong result.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// Built by the host Makefile only, other build systems compiling all
+// sources of the library skip it
+#ifdef PN5180_HOST
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "PN5180Discovery.h"
+#include "PN5180ISO15693Cache.h"
+#include "PN5180NDEF.h"
+#include "MockPN5180.h"
+
+#define PIN_NSS  16
+#define PIN_BUSY 5
+#define PIN_RST  17
+#define PIN_IRQ  4
+
+#ifndef BENCHMARK_ITERATIONS
+#define BENCHMARK_ITERATIONS 100
+#endif
+
+static const uint8_t ntagUid[7] = { 0x04, 0x5E, 0x21, 0x8A, 0x6B, 0x5C, 0x80 };
+static const uint8_t classicUid[4] = { 0x3A, 0xC2, 0x7F, 0x15 };
+static const uint8_t iso15693Uid[8] = { 0x6E, 0x2F, 0x41, 0x07, 0x50, 0x01, 0x04, 0xE0 };
+static const uint8_t iso15693Uid2[8] = { 0x91, 0x2F, 0x41, 0x07, 0x50, 0x01, 0x04, 0xE0 };
+
+// NDEF message on the NTAG and the second ISO15693 tag, one text record
+static const uint8_t ndefMessage[24] = { 0xD1, 0x01, 0x14, 'T', 0x02, 'e', 'n',
+  'P', 'N', '5', '1', '8', '0', ' ', 'b', 'e', 'n', 'c', 'h', 'm', 'a', 'r', 'k', '!' };
+
+enum {
+  TAG_NTAG = 0,
+  TAG_CLASSIC,
+  TAG_ISO15693,
+  TAG_ISO15693_2
+};
+
+static int failures = 0;
+
+#ifdef DEBUG
+// needed by the library with DEBUG, as in the example sketches
+void showIRQStatus(uint32_t irqStatus) {
+  printf("IRQ-Status 0x%08x\n", (unsigned)irqStatus);
+}
+#endif
+
+static void printHeader(const char *setup) {
+  printf("\n%s\n", setup);
+  printf("%-34s %8s %8s %8s %9s %9s %8s %10s\n",
+         "operation (per call)", "commands", "spi-tx", "frames", "bytes-out", "bytes-in", "rf", "time-us");
+}
+
+/*
+ * Runs op BENCHMARK_ITERATIONS times and prints the counters per call
+ */
+static void run(const char *name, MockPN5180 &mock, bool (*op)(PN5180Discovery &), PN5180Discovery &nfc) {
+  bool ok = true;
+  mock.resetCounters();
+  unsigned long long start = mock.getTimeNs();
+  for (int i = 0; ok && (i < BENCHMARK_ITERATIONS); i++) {
+    ok = op(nfc);
+  }
+  const MockPN5180Counters &c = mock.getCounters();
+  double n = BENCHMARK_ITERATIONS;
+  printf("%-34s %8.1f %8.1f %8.1f %9.1f %9.1f %8.1f %10.1f%s\n", name,
+         c.commands / n, c.transactions / n, c.spiFrames / n, c.bytesSent / n, c.bytesReceived / n,
+         c.rfFrames / n, (mock.getTimeNs() - start) / 1000.0 / n, ok ? "" : "  FAILED");
+  if (!ok) failures++;
+}
+
+static void onlyInField(MockPN5180 &mock, int8_t a, int8_t b = -1) {
+  for (int8_t i = TAG_NTAG; i <= TAG_ISO15693_2; i++) {
+    mock.setTagInField(i, (i == a) || (i == b));
+  }
+}
+
+static bool activateNtag(PN5180Discovery &nfc) {
+  uint8_t buffer[13];
+  return (7 == nfc.activateTypeA(buffer, 1)) && (0 == memcmp(buffer + 3, ntagUid, 7));
+}
+
+static bool activateNone(PN5180Discovery &nfc) {
+  uint8_t buffer[13];
+  return (0 == nfc.activateTypeA(buffer, 1));
+}
+
+// anticollision between the 7 byte and the 4 byte UID, the field is reset
+// first, as the cards stay halted within one RF session
+static bool activateTwoCards(PN5180Discovery &nfc) {
+  uint8_t uids[2 * 10];
+  uint8_t uidLengths[2];
+  return nfc.setRF_off() && nfc.PN5180ISO14443::setupRF() &&
+         (2 == nfc.readAllCardSerials(uids, uidLengths, 2));
+}
+
+static bool ntagFastRead(PN5180Discovery &nfc) {
+  uint8_t buffer[13];
+  uint8_t pages[16 * 4];
+  return (7 == nfc.activateTypeA(buffer, 1)) && nfc.ntagFastRead(4, 19, pages);
+}
+
+static bool inventory(PN5180Discovery &nfc) {
+  uint8_t uid[8];
+  return (ISO15693_EC_OK == nfc.getInventory(uid)) && (0 == memcmp(uid, iso15693Uid, 8));
+}
+
+static bool inventoryNone(PN5180Discovery &nfc) {
+  uint8_t uid[8];
+  return (EC_NO_CARD == nfc.getInventory(uid));
+}
+
+static bool inventoryMultiple(PN5180Discovery &nfc) {
+  uint8_t uids[4 * 8];
+  uint8_t numTags = 0;
+  return (ISO15693_EC_OK == nfc.getInventoryMultiple(uids, 4, &numTags)) && (2 == numTags);
+}
+
+// block n of the tag holds 4n..4n+3
+static bool readSingleBlock(PN5180Discovery &nfc) {
+  uint8_t block[4];
+  return (ISO15693_EC_OK == nfc.readSingleBlock((uint8_t *)iso15693Uid, 5, block, 4)) &&
+         (20 == block[0]) && (21 == block[1]) && (22 == block[2]) && (23 == block[3]);
+}
+
+static bool readMultipleBlocks(PN5180Discovery &nfc) {
+  uint8_t blocks[32 * 4];
+  if (ISO15693_EC_OK != nfc.readMultipleBlocks((uint8_t *)iso15693Uid, 0, 32, blocks, 4))
+    return false;
+  for (uint8_t i = 0; i < sizeof(blocks); i++) {
+    if (blocks[i] != i) return false;
+  }
+  return true;
+}
+
+static bool getSystemInfo(PN5180Discovery &nfc) {
+  uint8_t uid[8];
+  memcpy(uid, iso15693Uid, 8);
+  uint8_t blockSize = 0, numBlocks = 0;
+  return (ISO15693_EC_OK == nfc.getSystemInfo(uid, &blockSize, &numBlocks)) &&
+         (4 == blockSize) && (64 == numBlocks);
+}
+
+// begin() and 2 reads of 16 blocks, the second one from the buffer
+static bool cacheRead(PN5180Discovery &nfc) {
+  uint8_t storage[16 * 4];
+  uint8_t blocks[16 * 4];
+  PN5180ISO15693Cache cache(nfc, iso15693Uid, storage, sizeof(storage));
+  if ((ISO15693_EC_OK != cache.begin()) || (64 != cache.getNumBlocks()))
+    return false;
+  for (uint8_t n = 0; n < 2; n++) {
+    memset(blocks, 0, sizeof(blocks));
+    if (ISO15693_EC_OK != cache.readBlocks(0, 16, blocks))
+      return false;
+    for (uint8_t i = 0; i < sizeof(blocks); i++) {
+      if (blocks[i] != i) return false;
+    }
+  }
+  return true;
+}
+
+static bool readNDEFMessage(PN5180NDEFTag &tag) {
+  PN5180NDEF ndef(tag);
+  uint8_t message[32];
+  uint16_t len = 0;
+  return ndef.begin() && ndef.readMessage(message, sizeof(message), &len) &&
+         (sizeof(ndefMessage) == len) && (0 == memcmp(message, ndefMessage, len));
+}
+
+static bool ndefType2(PN5180Discovery &nfc) {
+  uint8_t buffer[13];
+  if (7 != nfc.activateTypeA(buffer, 1))
+    return false;
+  PN5180NDEFType2Tag tag(nfc);
+  return readNDEFMessage(tag);
+}
+
+static bool ndefType5(PN5180Discovery &nfc) {
+  PN5180NDEFType5Tag tag(nfc, iso15693Uid2);
+  return readNDEFMessage(tag);
+}
+
+// NDEF message TLV at dataStart, after the capability container
+static void scriptNDEF(MockTag *tag, const uint8_t *cc, uint16_t ccOffset, uint16_t dataStart) {
+  memcpy(&tag->memory[ccOffset], cc, 4);
+  tag->memory[dataStart] = 0x03;
+  tag->memory[dataStart + 1] = sizeof(ndefMessage);
+  memcpy(&tag->memory[dataStart + 2], ndefMessage, sizeof(ndefMessage));
+  tag->memory[dataStart + 2 + sizeof(ndefMessage)] = 0xFE;
+}
+
+static bool discoverNone(PN5180Discovery &nfc) {
+  uint8_t uid[10];
+  uint8_t uidLength;
+  return (PN5180_TECH_NONE == nfc.discover(uid, &uidLength));
+}
+
+static bool discoverISO15693(PN5180Discovery &nfc) {
+  uint8_t uid[10];
+  uint8_t uidLength;
+  return (PN5180_TECH_ISO15693 == nfc.discover(uid, &uidLength)) && (8 == uidLength);
+}
+
+static void benchmark(const char *setup, uint8_t irqPin) {
+  MockPN5180 mock(PIN_NSS, PIN_BUSY, PIN_RST, irqPin);
+  mock.addTagISO14443A(ntagUid, 7, 0x00, 0x0044, 45);
+  mock.addTagISO14443A(classicUid, 4, 0x08, 0x0004, 64);
+  mock.addTagISO15693(iso15693Uid, 4, 64);
+  mock.addTagISO15693(iso15693Uid2, 4, 64);
+  // Type 2: CC in page 3, data from page 4; Type 5: CC in block 0 with MBREAD
+  const uint8_t type2CC[4] = { 0xE1, 0x10, 0x12, 0x00 };
+  const uint8_t type5CC[4] = { 0xE1, 0x40, 0x20, 0x01 };
+  scriptNDEF(mock.getTag(TAG_NTAG), type2CC, 12, 16);
+  scriptNDEF(mock.getTag(TAG_ISO15693_2), type5CC, 0, 4);
+
+  PN5180Discovery nfc(PIN_NSS, PIN_BUSY, PIN_RST, irqPin, mock);
+  nfc.begin();
+  printHeader(setup);
+
+  mock.resetCounters();
+  unsigned long long start = mock.getTimeNs();
+  bool ok = nfc.reset();
+  printf("%-34s %8u %8u %8u %9u %9u %8u %10.1f%s\n", "reset", mock.getCounters().commands,
+         mock.getCounters().transactions, mock.getCounters().spiFrames, mock.getCounters().bytesSent,
+         mock.getCounters().bytesReceived, mock.getCounters().rfFrames,
+         (mock.getTimeNs() - start) / 1000.0, ok ? "" : "  FAILED");
+  if (!ok) failures++;
+
+  nfc.PN5180ISO14443::setupRF();
+  onlyInField(mock, TAG_NTAG);
+  run("activateTypeA, 7 byte UID", mock, activateNtag, nfc);
+  run("activateTypeA + ntagFastRead 64B", mock, ntagFastRead, nfc);
+  run("activateTypeA + NDEF Type 2 read", mock, ndefType2, nfc);
+  onlyInField(mock, -1);
+  run("activateTypeA, no card", mock, activateNone, nfc);
+  onlyInField(mock, TAG_NTAG, TAG_CLASSIC);
+  run("RF reset + readAllCardSerials, 2", mock, activateTwoCards, nfc);
+
+  nfc.setRF_off();
+  nfc.PN5180ISO15693::setupRF();
+  onlyInField(mock, TAG_ISO15693);
+  run("getInventory", mock, inventory, nfc);
+  run("readSingleBlock", mock, readSingleBlock, nfc);
+  run("readMultipleBlocks, 32 x 4B", mock, readMultipleBlocks, nfc);
+  run("getSystemInfo", mock, getSystemInfo, nfc);
+  run("PN5180ISO15693Cache, 2 x 16 blocks", mock, cacheRead, nfc);
+  onlyInField(mock, TAG_ISO15693_2);
+  run("NDEF Type 5 read", mock, ndefType5, nfc);
+  onlyInField(mock, -1);
+  run("getInventory, no tag", mock, inventoryNone, nfc);
+  onlyInField(mock, TAG_ISO15693, TAG_ISO15693_2);
+  run("getInventoryMultiple, 2 tags", mock, inventoryMultiple, nfc);
+
+  onlyInField(mock, -1);
+  run("discover, no tag", mock, discoverNone, nfc);
+  onlyInField(mock, TAG_ISO15693);
+  run("discover, ISO15693 tag", mock, discoverISO15693, nfc);
+
+  if (mock.getCounters().errors > 0) {
+    printf("*** %u commands raised GENERAL_ERROR_IRQ\n", mock.getCounters().errors);
+    failures++;
+  }
+  nfc.end();
+}
+
+int main() {
+  printf("PN5180 host benchmark, %d iterations, SPI clock %lu Hz\n",
+         BENCHMARK_ITERATIONS, (unsigned long)PN5180_SPI_CLOCK);
+  benchmark("IRQ_STATUS polled over SPI (PN5180_NO_IRQ_PIN)", PN5180_NO_IRQ_PIN);
+  benchmark("IRQ pin", PIN_IRQ);
+  if (failures > 0) {
+    printf("\n%d operations FAILED\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+#endif /* PN5180_HOST */
@@ -0,0 +1,273 @@
+// NAME: test.cpp
+//
+// DESC: Host tests of the library against MockPN5180, checks the data
+//       returned and written by getSystemInfo, PN5180ISO15693Cache and
+//       PN5180NDEF on Type 2 and Type 5 tags, and the IRQ pin waits.
+//       Exits with 1 if a check failed.
+//
+// This file is part of the PN5180 library for the Arduino environment.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// Built by the host Makefile only, other build systems compiling all
+// sources of the library skip it
+#ifdef PN5180_HOST
+
+#include <stdio.h>
+#include <Arduino.h>
+#include "PN5180Discovery.h"
+#include "PN5180ISO15693Cache.h"
+#include "PN5180NDEF.h"
+#include "MockPN5180.h"
+
+#define PIN_NSS  16
+#define PIN_BUSY 5
+#define PIN_RST  17
+#define PIN_IRQ  4
+
+static const uint8_t ntagUid[7] = { 0x04, 0x5E, 0x21, 0x8A, 0x6B, 0x5C, 0x80 };
+static const uint8_t iso15693Uid[8] = { 0x6E, 0x2F, 0x41, 0x07, 0x50, 0x01, 0x04, 0xE0 };
+
+// Text record "en" "Hello"
+static const uint8_t textRecord[12] = { 0xD1, 0x01, 0x08, 'T', 0x02, 'e', 'n', 'H', 'e', 'l', 'l', 'o' };
+// URI record "https://" "pn5180.x"
+static const uint8_t uriRecord[13] = { 0xD1, 0x01, 0x09, 'U', 0x04, 'p', 'n', '5', '1', '8', '0', '.', 'x' };
+
+static int checks = 0;
+static int failures = 0;
+
+#ifdef DEBUG
+// needed by the library with DEBUG, as in the example sketches
+void showIRQStatus(uint32_t irqStatus) {
+  printf("IRQ-Status 0x%08x\n", (unsigned)irqStatus);
+}
+#endif
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+  checks++;
+  if (!ok) {
+    printf("  FAILED line %d: %s\n", line, what);
+    failures++;
+  }
+}
+
+// content of block blockNo as set by MockPN5180::addTagISO15693()
+static bool isInitialBlock(const uint8_t *data, uint8_t blockNo, uint8_t blockSize) {
+  for (uint8_t i = 0; i < blockSize; i++) {
+    if (data[i] != (uint8_t)(blockNo * blockSize + i)) return false;
+  }
+  return true;
+}
+
+static void testSystemInfo(PN5180Discovery &nfc) {
+  printf("getSystemInfo\n");
+  uint8_t uid[8];
+  memcpy(uid, iso15693Uid, 8);
+  uint8_t blockSize = 0, numBlocks = 0;
+  CHECK(ISO15693_EC_OK == nfc.getSystemInfo(uid, &blockSize, &numBlocks));
+  CHECK(4 == blockSize);
+  CHECK(64 == numBlocks);
+  CHECK(0 == memcmp(uid, iso15693Uid, 8));
+
+  PN5180ISO15693::Session session(nfc, iso15693Uid);
+  blockSize = numBlocks = 0;
+  CHECK(ISO15693_EC_OK == session.getSystemInfo(&blockSize, &numBlocks));
+  CHECK(4 == blockSize);
+  CHECK(64 == numBlocks);
+}
+
+static void testCache(PN5180Discovery &nfc, MockPN5180 &mock, MockTag *tag) {
+  printf("PN5180ISO15693Cache\n");
+  uint8_t storage[16 * 4];
+  PN5180ISO15693Cache cache(nfc, iso15693Uid, storage, sizeof(storage));
+  CHECK(ISO15693_EC_OK == cache.begin());
+  CHECK(4 == cache.getBlockSize());
+  CHECK(64 == cache.getNumBlocks());
+  CHECK(16 == cache.getCachedBlocks());
+
+  // cached block, the second read is served from the buffer
+  uint8_t block[4];
+  CHECK((ISO15693_EC_OK == cache.readBlock(5, block)) && isInitialBlock(block, 5, 4));
+  mock.resetCounters();
+  CHECK((ISO15693_EC_OK == cache.readBlock(5, block)) && isInitialBlock(block, 5, 4));
+  CHECK(0 == mock.getCounters().rfFrames);
+
+  // run across the end of the buffer
+  uint8_t blocks[4 * 4];
+  CHECK(ISO15693_EC_OK == cache.readBlocks(14, 4, blocks));
+  for (uint8_t i = 0; i < 4; i++) CHECK(isInitialBlock(blocks + 4 * i, 14 + i, 4));
+  CHECK((ISO15693_EC_OK == cache.readBlock(40, block)) && isInitialBlock(block, 40, 4));
+
+  // write-back of cached blocks with flush()
+  const uint8_t data[8] = { 0xA0, 0xA1, 0xA2, 0xA3, 0xB0, 0xB1, 0xB2, 0xB3 };
+  CHECK(ISO15693_EC_OK == cache.writeBlocks(6, 2, data));
+  CHECK(cache.isDirty());
+  CHECK(isInitialBlock(&tag->memory[6 * 4], 6, 4));
+  CHECK((ISO15693_EC_OK == cache.readBlock(7, block)) && (0 == memcmp(block, data + 4, 4)));
+  CHECK(ISO15693_EC_OK == cache.flush());
+  CHECK(!cache.isDirty());
+  CHECK(0 == memcmp(&tag->memory[6 * 4], data, 8));
+  CHECK(isInitialBlock(&tag->memory[5 * 4], 5, 4) && isInitialBlock(&tag->memory[8 * 4], 8, 4));
+
+  // blocks beyond the buffer are written immediately
+  CHECK(ISO15693_EC_OK == cache.writeBlock(50, data));
+  CHECK(0 == memcmp(&tag->memory[50 * 4], data, 4));
+
+  // read from the tag again after invalidate()
+  tag->memory[6 * 4] = 0x55;
+  cache.invalidate();
+  CHECK((ISO15693_EC_OK == cache.readBlock(6, block)) && (0x55 == block[0]) && (0xA1 == block[1]));
+  CHECK(ISO15693_EC_BLOCK_NOT_AVAILABLE == cache.readBlock(64, block));
+}
+
+struct RecordInfo {
+  uint8_t records;
+  uint8_t type;
+  uint32_t payloadLength;
+  uint8_t payload[16];
+};
+
+static bool onRecord(const PN5180NDEFRecord *record, const uint8_t *data, uint32_t offset, uint16_t len, void *arg) {
+  RecordInfo *info = (RecordInfo *)arg;
+  if (0 == offset) {
+    info->records++;
+    info->type = record->type[0];
+    info->payloadLength = record->payloadLength;
+  }
+  for (uint16_t i = 0; (i < len) && (offset + i < sizeof(info->payload)); i++) {
+    info->payload[offset + i] = data[i];
+  }
+  return true;
+}
+
+/*
+ * Reads the text record at dataStart of the tag memory, writes the URI
+ * record and reads it back. TLV header and terminator are written into
+ * partial pages/blocks, the other bytes have to keep their content.
+ */
+static void testNDEF(PN5180NDEFTag &ndefTag, MockTag *tag, uint16_t dataStart) {
+  PN5180NDEF ndef(ndefTag);
+  CHECK(ndef.begin());
+  CHECK(12 == ndef.getMessageLength());
+  CHECK(!ndef.isReadOnly());
+
+  uint8_t message[32];
+  uint16_t len = 0;
+  CHECK(ndef.readMessage(message, sizeof(message), &len));
+  CHECK((12 == len) && (0 == memcmp(message, textRecord, 12)));
+  RecordInfo info;
+  memset(&info, 0, sizeof(info));
+  CHECK(ndef.readMessage(onRecord, &info));
+  CHECK((1 == info.records) && ('T' == info.type) && (8 == info.payloadLength));
+  CHECK(0 == memcmp(info.payload, textRecord + 4, 8));
+
+  uint8_t before[MOCK_PN5180_TAG_MEMORY];
+  memcpy(before, tag->memory, sizeof(before));
+  CHECK(ndef.writeMessage(uriRecord, sizeof(uriRecord)));
+  const uint8_t *p = &tag->memory[dataStart];
+  CHECK((0x03 == p[0]) && (sizeof(uriRecord) == p[1]));
+  CHECK(0 == memcmp(p + 2, uriRecord, sizeof(uriRecord)));
+  CHECK(0xFE == p[2 + sizeof(uriRecord)]);
+  uint16_t end = dataStart + 3 + sizeof(uriRecord);
+  CHECK(0 == memcmp(before, tag->memory, dataStart));
+  CHECK(0 == memcmp(before + end, tag->memory + end, sizeof(before) - end));
+
+  PN5180NDEF reread(ndefTag);
+  CHECK(reread.begin());
+  len = 0;
+  CHECK(reread.readMessage(message, sizeof(message), &len));
+  CHECK((sizeof(uriRecord) == len) && (0 == memcmp(message, uriRecord, len)));
+}
+
+// NTAG213: CC in page 3 with 144 bytes data area, data area from page 4
+static void testNDEFType2(PN5180Discovery &nfc, MockTag *tag) {
+  printf("PN5180NDEF, Type 2\n");
+  const uint8_t cc[4] = { 0xE1, 0x10, 0x12, 0x00 };
+  memcpy(&tag->memory[12], cc, 4);
+  tag->memory[16] = 0x03;
+  tag->memory[17] = sizeof(textRecord);
+  memcpy(&tag->memory[18], textRecord, sizeof(textRecord));
+  tag->memory[18 + sizeof(textRecord)] = 0xFE;
+  for (uint16_t i = 19 + sizeof(textRecord); i < 4 * tag->numBlocks; i++) tag->memory[i] = (uint8_t)i;
+
+  uint8_t buffer[13];
+  CHECK(7 == nfc.activateTypeA(buffer, 1));
+  PN5180NDEFType2Tag type2(nfc);
+  testNDEF(type2, tag, 16);
+}
+
+// CC in block 0 with 256 bytes data area, the MBREAD bit selects
+// READ MULTIPLE BLOCKS, else the tag is read with READ SINGLE BLOCK
+static void testNDEFType5(PN5180Discovery &nfc, MockTag *tag, bool multiBlockRead) {
+  printf("PN5180NDEF, Type 5, %s\n", multiBlockRead ? "READ MULTIPLE BLOCKS" : "READ SINGLE BLOCK");
+  for (uint16_t i = 0; i < MOCK_PN5180_TAG_MEMORY; i++) tag->memory[i] = (uint8_t)i;
+  const uint8_t cc[4] = { 0xE1, 0x40, 0x20, (uint8_t)(multiBlockRead ? 0x01 : 0x00) };
+  memcpy(&tag->memory[0], cc, 4);
+  tag->memory[4] = 0x03;
+  tag->memory[5] = sizeof(textRecord);
+  memcpy(&tag->memory[6], textRecord, sizeof(textRecord));
+  tag->memory[6 + sizeof(textRecord)] = 0xFE;
+
+  PN5180NDEFType5Tag type5(nfc, iso15693Uid);
+  testNDEF(type5, tag, 4);
+}
+
+/*
+ * With the IRQ pin, IRQ_STATUS is read once per awaited event (TX, SOF, RX),
+ * not polled for the duration of the response
+ */
+static void testIRQWaits(PN5180Discovery &nfc, MockPN5180 &mock) {
+  printf("IRQ pin waits\n");
+  uint8_t blocks[32 * 4];
+  mock.resetCounters();
+  CHECK(ISO15693_EC_OK == nfc.readMultipleBlocks((uint8_t *)iso15693Uid, 0, 32, blocks, 4));
+  CHECK(mock.getCounters().command[0x04] <= 8);
+  mock.resetCounters();
+  CHECK(ISO15693_EC_OK == nfc.readSingleBlock((uint8_t *)iso15693Uid, 0, blocks, 4));
+  CHECK(mock.getCounters().command[0x04] <= 8);
+}
+
+static void test(const char *setup, uint8_t irqPin) {
+  printf("\n%s\n", setup);
+  MockPN5180 mock(PIN_NSS, PIN_BUSY, PIN_RST, irqPin);
+  int8_t ntagTag = mock.addTagISO14443A(ntagUid, 7, 0x00, 0x0044, 45);
+  int8_t iso15693Tag = mock.addTagISO15693(iso15693Uid, 4, 64);
+
+  PN5180Discovery nfc(PIN_NSS, PIN_BUSY, PIN_RST, irqPin, mock);
+  nfc.begin();
+  CHECK(nfc.reset());
+
+  CHECK(nfc.PN5180ISO15693::setupRF());
+  testSystemInfo(nfc);
+  if (PN5180_NO_IRQ_PIN != irqPin) testIRQWaits(nfc, mock);
+  testCache(nfc, mock, mock.getTag(iso15693Tag));
+  testNDEFType5(nfc, mock.getTag(iso15693Tag), false);
+  testNDEFType5(nfc, mock.getTag(iso15693Tag), true);
+  nfc.setRF_off();
+
+  CHECK(nfc.PN5180ISO14443::setupRF());
+  testNDEFType2(nfc, mock.getTag(ntagTag));
+  nfc.setRF_off();
+
+  CHECK(0 == mock.getCounters().errors);
+  nfc.end();
+}
+
+int main() {
+  test("IRQ_STATUS polled over SPI (PN5180_NO_IRQ_PIN)", PN5180_NO_IRQ_PIN);
+  test("IRQ pin", PIN_IRQ);
+  printf("\n%d checks, %d failed\n", checks, failures);
+  return (failures > 0) ? 1 : 0;
+}
+
+#endif /* PN5180_HOST */